@@ -155,17 +155,99 @@ namespace lambda {
 		static const size_t stack_margin			= 0x4000;
 		static const unsigned int stack_chunk_size	= 1024;
 
-		enum gc_type_t { gc_none, gc_mark_sweep };
+		enum gc_type_t { gc_none, gc_mark_sweep, gc_conservative };
+		// find the roots by scanning the machine stacks, instead of tracking every pointer
+#ifdef LAMBDA_CONSERVATIVE_GC
+		static const gc_type_t gc_type				= gc_conservative;
+#else
 		static const gc_type_t gc_type				= gc_mark_sweep;
+#endif
+		// track the roots in a contiguous array per worker, instead of a list through the pointers
+#ifdef LAMBDA_SHADOW_STACK
+		static const bool gc_shadow_stack			= true;
+#else
+		static const bool gc_shadow_stack			= false;
+#endif
+		static const size_t gc_shadow_stack_size	= 0x10000;
 #ifdef LAMBDA_PLATFORM_MB
 		static const bool workers_cpu_bound			= true;
 		static const size_t macroblock_size			= (1<<max(22-(int)workers,18));
-		static const int global_gc_interval_ms		= 5000;
+		static const int global_gc_interval_ms		= 0;
 #else
 		static const bool workers_cpu_bound			= false && workers>8;
 		static const size_t macroblock_size			= (1<<max(25-(int)workers,20));
-		static const int global_gc_interval_ms		= 1000;
+		static const int global_gc_interval_ms		= 0;
+#endif
+		// global_gc_interval_ms>0 adds a timer that triggers a global GC periodically, regardless of the heap growth
+
+		// index of the free heap elements: an address-sorted list, or a tree with logarithmic coalescing and lookup
+		enum heap_free_t { heap_free_list, heap_free_tree };
+#ifdef LAMBDA_HEAP_FREE_TREE
+		static const heap_free_t heap_free			= heap_free_tree;
+#else
+		static const heap_free_t heap_free			= heap_free_list;
+#endif
+		// number of empty macroblocks a worker keeps after a global GC, the others are given back to the OS
+		static const size_t macroblock_retain		= 2;
+		// give empty macroblocks back by unmapping them, or only by discarding their pages
+		static const bool macroblock_unmap			= true;
+		// segregated free lists for small terms, one per HEAP_ELEM_ALIGNMENT size step; local terms up to this size live in slabs
+		static const size_t heap_size_classes		= 16;
+		// size of the slabs that hold small local terms without a header per term, 0 disables the slabs
+		static const size_t heap_slab_size			= 4096;
+		// NoTerm blocks of at least this size are mapped separately instead of recycled in power-of-two classes
+		static const size_t heap_noterm_large		= 0x4000;
+		// minimum size of a free block to bump-allocate the locals in that do not fit a slab, 0 disables the nursery
+		static const size_t nursery_chunk_size		= 4096;
+		// minimum size of a gap between nursery survivors to bump-allocate in again
+		static const size_t nursery_gap_size		= 1024;
+		// a worker's heap grows to gc_heap_growth times the data that survived the last GC before it collects again,
+		// which bounds the GC work per allocated byte; a global GC is triggered when the globals of a worker grew
+		// by the same factor since the last global GC, and take at least gc_global_min bytes (dead globals
+		// fragment the local heap, so this is kept small)
+		static const size_t gc_heap_growth			= 2;
+		static const size_t gc_global_min			= macroblock_size/32;
+#ifdef LAMBDA_COMPACT_GC
+		// bytes of live global applications a worker moves to free space at a lower address during a stop-the-world
+		// global GC; the old copy is left behind as indirection, 0 disables the compaction
+		static const size_t gc_compact_size			= macroblock_size/8;
+#else
+		static const size_t gc_compact_size			= 0;
+#endif
+		// every n-th local GC also collects the tenured locals, 1 disables the generations
+		static const int local_gc_full_interval		= 8;
+		// number of globals per shared packet during global marking, 0 disables parallel marking
+		static const int gc_mark_packet_size		= 64;
+#ifdef LAMBDA_INCREMENTAL_GC
+		static const bool gc_incremental			= true;
+#else
+		static const bool gc_incremental			= false;
+#endif
+		// number of globals to mark per incremental step, in between evaluation
+		static const unsigned int gc_incremental_step = 256;
+#ifdef LAMBDA_LAZY_SWEEP
+		static const bool gc_lazy_sweep			= true;
+#else
+		static const bool gc_lazy_sweep			= false;
+#endif
+		// give all locals of a worker back at once when it finished a spark, instead of collecting them
+#ifdef LAMBDA_SPARK_REGIONS
+		static const bool gc_spark_regions		= true;
+#else
+		static const bool gc_spark_regions		= false;
+#endif
+		// number of elements to sweep per allocation that runs out of memory, after a lazy GC
+		static const size_t gc_lazy_sweep_step		= 256;
+		// number of global GC pauses to keep for the statistics
+		static const unsigned int stats_pauses		= 4096;
+		// write the live terms per type and per allocating function after every GC to a csv file per worker
+#ifdef LAMBDA_GC_CENSUS
+		static const bool gc_census					= true;
+#else
+		static const bool gc_census					= false;
 #endif
+		// number of term types the census distinguishes
+		static const int gc_census_types			= 32;
 
 		static const int max_name_depth				= 5;
 		static const lcfloat_t epsilon				;//= 0.00001;
@@ -29,9 +29,16 @@ namespace lambda {
 	template <Config::gc_type_t gc=Config::gc_type> class Heap {};
 	static bool gc_barrier_wait(bool reset_state=false) __attribute__((unused));
 	static bool gc_trigger_global() __attribute__((unused));
+	static void gc_request_global() __attribute__((unused));
 	static bool worker_inspect_state() __attribute__((unused));
 	static void queue_mark_active(Stack<Term*>& more_active) __attribute__((unused));
+	static void gc_mark_reset() __attribute__((unused));
+	static void gc_mark_share(Stack<Term*>& marking) __attribute__((unused));
+	static bool gc_mark_steal(Stack<Term*>& marking) __attribute__((unused));
+	static bool gc_marking_start() __attribute__((unused));
+	static void gc_marking_done() __attribute__((unused));
 	static void dot_marked(Stack<Term*>& m) __attribute__((unused));
+	static void* worker_stack_top() __attribute__((unused));
 
 	class NoTerm : public Term {};
 
@@ -44,9 +51,23 @@ namespace lambda {
 		static void Free(void* p){
 			return ::operator delete(p);
 		}
+		static void* Realloc(void* p,size_t old_s,size_t new_s){
+			void* res=::operator new(new_s);
+			memcpy(res,p,old_s);
+			::operator delete(p);
+			return res;
+		}
+		static void Remember(Term* t){}
+		static bool IsMarked(Term* t){return false;}
+		static void Mark(Term* t){}
+		static void Unmark(Term* t){}
+		static void Snapshot(Term* t){}
+		static bool IsMarking(){return false;}
+		static bool MarkStep(){return false;}
 		static bool DoGC(bool only_local){
 			return true;
 		}
+		static void DropLocals(){}
 	};
 };
 
@@ -48,6 +48,7 @@ namespace lambda {
 		void SetNext(HeapElement* next){m_next=next;}
 		inline size_t Size() const {return m_size;}
 		inline size_t Sizeof() const {return sizeof(HeapElement)+Size();}
+		void Resize(size_t size){m_size=size-sizeof(HeapElement);}
 		HeapElement* Next(){return m_next;}
 		Term* GetTerm(){return m_term;}
 		void SetTerm(Term* term){m_term=term;}
@@ -248,6 +249,60 @@ namespace lambda {
 			m_it.drop();
 			return e;
 		}
+		// split off s bytes of the first element from the cursor on that is large enough, NULL at the end of the list
+		HeapElement* fit(size_t s){
+			for(Iterator& it=m_it;it.cur();it++)
+				if(it.cur()->Size()>=s)
+					return it.use(s);
+			return NULL;
+		}
+		// remove an element of at least s bytes, search from the cursor on first
+		HeapElement* takeAtLeast(size_t s){
+			Iterator cursor=m_it;
+			for(int pass=0;pass<2;pass++)
+				for(Iterator& it=pass?iterate():m_it;it.cur();it++)
+					if(it.cur()->Size()>=s)
+						return it.drop();
+			// let fit() continue where it was
+			m_it=cursor;
+			return NULL;
+		}
+		void rewind(){iterate();}
+		// prepend e, for lists that do not need to be sorted
+		HeapElement* push(HeapElement* e){
+			e->SetNext(m_head);
+			m_head=e;
+			iterate();
+			return e;
+		}
+		// merge an unsorted chain of elements into this list, and coalesce all neighbours
+		void mergeAll(HeapElement* chain){
+			HeapElement* e=chain;
+			if(!e)
+				return;
+			while(e->Next())
+				e=e->Next();
+			e->SetNext(m_head);
+			m_head=sort(chain);
+			for(e=m_head;e;e=e->Next()){
+				HeapElement* n;
+				while((n=e->Next())){
+					HeapElement* nn=n->Next();
+					if(!e->Merge(n))
+						break;
+					e->SetNext(nn);
+				}
+			}
+			iterate();
+		}
+		// move all elements of l to this empty list
+		void take(HeapElementList& l){
+			LAMBDA_ASSERT(isEmpty(),"taking elements into non-empty list");
+			m_head=l.m_head;
+			l.m_head=NULL;
+			l.iterate();
+			iterate();
+		}
 		bool isEmpty(){return m_head==NULL;}
 		int size(){
 			int res=0;
@@ -268,21 +323,219 @@ namespace lambda {
 			Iterator(m_head).check();
 #endif
 		}
+	protected:
+		// bottom-up merge sort on address
+		static HeapElement* sort(HeapElement* list){
+			for(size_t width=1;;width*=2){
+				HeapElement *head=NULL,*last=NULL;
+				size_t merges=0;
+				while(list){
+					HeapElement *a=list,*b=list;
+					size_t na=0,nb=width;
+					for(;b&&na<width;na++)
+						b=b->Next();
+					merges++;
+					while(na||(nb&&b)){
+						HeapElement* e;
+						if(na&&(!nb||!b||(uintptr_t)a<(uintptr_t)b)){
+							e=a;a=a->Next();na--;
+						}else{
+							e=b;b=b->Next();nb--;
+						}
+						if(last)last->SetNext(e);else head=e;
+						last=e;
+					}
+					list=b;
+				}
+				if(last)last->SetNext(NULL);
+				list=head;
+				if(merges<=1)
+					return list;
+			}
+		}
 	private:
 		HeapElement* m_head;
 		Iterator m_it;
 	};
 
+	// A macroblock is aligned to its size, such that the block, and therefore the mark bit, of any term can be found from its address.
+	// Free elements in a treap on address, in which every node knows the largest element in its subtree.
+	// The left child is stored in the next pointer, the right child in the term pointer, and the largest
+	// size in the buffer of the free element.
+	class HeapElementTree {
+	public:
+		HeapElementTree() : m_root(NULL), m_count() {}
+		// split off s bytes of the lowest element that is large enough
+		HeapElement* fit(size_t s){
+			HeapElement* e=Find(s);
+			if(!e)
+				return NULL;
+			Remove(e);
+			HeapElement* e_use=e->Split(s);
+			if(!e_use)
+				return e;
+			Insert(e);
+			return e_use;
+		}
+		// remove the lowest element of at least s bytes
+		HeapElement* takeAtLeast(size_t s){
+			HeapElement* e=Find(s);
+			if(e)
+				Remove(e);
+			return e;
+		}
+		// insert e, and coalesce it with its neighbours
+		void merge(HeapElement* e){
+			HeapElement *l,*r,*n;
+			SplitAt(m_root,(uintptr_t)e,l,r);
+			if(l){
+				HeapElement* p=Last(l);
+				if(p->Merge(e)){
+					SplitAt(l,(uintptr_t)p,l,n);
+					m_count--;
+					e=p;
+				}
+			}
+			if(r){
+				n=First(r);
+				if(e->Merge(n)){
+					SplitAt(r,(uintptr_t)n+1,n,r);
+					m_count--;
+				}
+			}
+			m_root=Join(Join(l,Leaf(e)),r);
+			m_count++;
+		}
+		void mergeAll(HeapElement* chain){
+			while(chain){
+				HeapElement* n=chain->Next();
+				merge(chain);
+				chain=n;
+			}
+		}
+		HeapElement* remove(HeapElement* e){Remove(e);return e;}
+		void rewind(){}
+		bool isEmpty(){return m_root==NULL;}
+		int size(){return m_count;}
+	protected:
+		static HeapElement* Left(HeapElement* n){return n->Next();}
+		static HeapElement* Right(HeapElement* n){return (HeapElement*)n->GetTerm();}
+		static void SetLeft(HeapElement* n,HeapElement* l){n->SetNext(l);}
+		static void SetRight(HeapElement* n,HeapElement* r){n->SetTerm((Term*)r);}
+		static size_t& Max(HeapElement* n){return *(size_t*)n->Buf();}
+		static size_t MaxOf(HeapElement* n){return n?Max(n):0;}
+		// pseudo-random priority, derived from the address
+		static uintptr_t Priority(HeapElement* n){
+			uintptr_t p=(uintptr_t)n/HEAP_ELEM_ALIGNMENT;
+			p=(p^(p>>15))*(uintptr_t)0x2c1b3c6du;
+			p=(p^(p>>12))*(uintptr_t)0x297a2d39u;
+			return p^(p>>15);
+		}
+		static HeapElement* Update(HeapElement* n){
+			size_t m=n->Size();
+			if(MaxOf(Left(n))>m)m=Max(Left(n));
+			if(MaxOf(Right(n))>m)m=Max(Right(n));
+			Max(n)=m;
+			return n;
+		}
+		static HeapElement* Leaf(HeapElement* n){
+			SetLeft(n,NULL);
+			SetRight(n,NULL);
+			return Update(n);
+		}
+		// split t in the nodes below key and the others
+		static void SplitAt(HeapElement* t,uintptr_t key,HeapElement*& l,HeapElement*& r){
+			if(!t){
+				l=r=NULL;
+			}else if((uintptr_t)t<key){
+				HeapElement* rl;
+				SplitAt(Right(t),key,rl,r);
+				SetRight(t,rl);
+				l=Update(t);
+			}else{
+				HeapElement* lr;
+				SplitAt(Left(t),key,l,lr);
+				SetLeft(t,lr);
+				r=Update(t);
+			}
+		}
+		// join two trees, where all nodes of l are below the ones of r
+		static HeapElement* Join(HeapElement* l,HeapElement* r){
+			if(!l)return r;
+			if(!r)return l;
+			if(Priority(l)>Priority(r)){
+				SetRight(l,Join(Right(l),r));
+				return Update(l);
+			}else{
+				SetLeft(r,Join(l,Left(r)));
+				return Update(r);
+			}
+		}
+		static HeapElement* First(HeapElement* t){while(Left(t))t=Left(t);return t;}
+		static HeapElement* Last(HeapElement* t){while(Right(t))t=Right(t);return t;}
+		HeapElement* Find(size_t s){
+			HeapElement* t=m_root;
+			if(MaxOf(t)<s)
+				return NULL;
+			while(true)
+				if(MaxOf(Left(t))>=s)
+					t=Left(t);
+				else if(t->Size()>=s)
+					return t;
+				else
+					t=Right(t);
+		}
+		void Insert(HeapElement* e){
+			HeapElement *l,*r;
+			SplitAt(m_root,(uintptr_t)e,l,r);
+			m_root=Join(Join(l,Leaf(e)),r);
+			m_count++;
+		}
+		void Remove(HeapElement* e){
+			HeapElement *l,*r,*n;
+			SplitAt(m_root,(uintptr_t)e,l,r);
+			SplitAt(r,(uintptr_t)e+1,n,r);
+			LAMBDA_ASSERT(n==e,"non-existent remove of %p",e);
+			m_root=Join(l,r);
+			m_count--;
+		}
+	private:
+		HeapElement* m_root;
+		int m_count;
+	};
+
+	// the free index, as selected by Config::heap_free
+	template <Config::heap_free_t f> struct heap_free { typedef HeapElementList type; };
+	template <> struct heap_free<Config::heap_free_tree> { typedef HeapElementTree type; };
+
 	class MacroBlock {
 	public:
-		MacroBlock(MacroBlock* next=NULL) : m_next(next) {}
+		MacroBlock(MacroBlock* next=NULL) : m_next(next) {
+			ClearMarks();
+			if(starts){
+				memset(m_starts,0,sizeof(m_starts));
+				m_owners[Index(this)]=(unsigned char)(worker_id()+1);
+			}
+		}
 		HeapElement* Init(){return new(buf) HeapElement(sizeof(buf)); }
 		static MacroBlock* Alloc(size_t s){
-			void* m=global_malloc(s+HEAP_ELEM_ALIGNMENT+sizeof(void*));
+#ifdef HAVE_MMAP
+			// map more than needed, and unmap the unaligned head and tail
+			char* m=(char*)global_mmap(s+Config::macroblock_size);
 			if(!m)return NULL;
-			void* p=HEAP_PTR_ALIGN((uintptr_t)m+sizeof(void*));
+			char* p=(char*)Of(m+Config::macroblock_size-1);
+			if(p>m)
+				global_munmap(m,p-m);
+			global_munmap(p+s,m+Config::macroblock_size-p);
+			global_hugepage(p,s);
+			return (MacroBlock*)p;
+#else
+			void* m=global_malloc(s+Config::macroblock_size+sizeof(void*));
+			if(!m)return NULL;
+			void* p=(void*)Of((char*)m+sizeof(void*)+Config::macroblock_size-1);
 			((void**)p)[-1]=m;
 			return (MacroBlock*)p;
+#endif
 		}
 		static void* operator new(size_t s){
 			void* m=Alloc(s);
@@ -294,22 +547,221 @@ namespace lambda {
 			return buf;
 		}
 		static void operator delete(void* p){
+			if(starts)
+				m_owners[Index(p)]=0;
+#ifdef HAVE_MMAP
+			global_munmap(p,sizeof(MacroBlock));
+#else
 			global_free(((void**)p)[-1]);
+#endif
 		}
 		MacroBlock* GetNext(){return m_next;}
+		void SetNext(MacroBlock* next){m_next=next;}
+		// returns the free element that spans the whole block, if it is empty
+		HeapElement* Empty(){
+			HeapElement* e=(HeapElement*)buf;
+			return e->Sizeof()==sizeof(buf)?e:NULL;
+		}
+		// give the pages of an empty block back to the OS, but keep the header of its free element
+		void Discard(){
+#ifdef HAVE_MMAP
+			char* p=(char*)(((uintptr_t)buf+sizeof(HeapElement)+sizeof(size_t)+PAGE_SIZE_MIN-1)&~(uintptr_t)(PAGE_SIZE_MIN-1));
+			global_discard(p,(char*)this+sizeof(*this)-p);
+#endif
+		}
+		static MacroBlock* Of(void* p){return (MacroBlock*)((uintptr_t)p&~(uintptr_t)(Config::macroblock_size-1));}
+		// mark bits, one per HEAP_ELEM_ALIGNMENT bytes
+		bool IsMarked(void* p){
+			size_t i=Bit(p);
+			return (m_marks[i/mark_bits]>>(i%mark_bits))&1;
+		}
+		void Mark(void* p){
+			size_t i=Bit(p);
+			uintptr_t b=(uintptr_t)1<<(i%mark_bits);
+			// other workers may mark globals in the same word
+			if(!(m_marks[i/mark_bits]&b))
+				atomic_or(&m_marks[i/mark_bits],b);
+		}
+		void Unmark(void* p){
+			size_t i=Bit(p);
+			uintptr_t b=(uintptr_t)1<<(i%mark_bits);
+			if(m_marks[i/mark_bits]&b)
+				atomic_and(&m_marks[i/mark_bits],~b);
+		}
+		void ClearMarks(){memset(m_marks,0,sizeof(m_marks));}
+
+		// With gc_conservative, every block knows where its allocated terms start, and a map
+		// tells which worker owns the block of any address, such that any word can be checked.
+		static void InitOwners(){
+			if(m_owners)
+				return;
+#ifdef HAVE_MMAP
+			m_owners=(unsigned char*)global_mmap(owners);
+#else
+			if((m_owners=(unsigned char*)global_malloc(owners)))
+				memset(m_owners,0,owners);
+#endif
+			if(!m_owners)
+				Error("cannot allocate macroblock map");
+		}
+		// the worker id+1 of the block that contains p, 0 if p is not in the heap
+		static int Owner(void* p){return Index(p)<owners?m_owners[Index(p)]:0;}
+		void SetStart(void* p){
+			size_t i=Bit(p);
+			m_starts[i/mark_bits]|=(uintptr_t)1<<(i%mark_bits);
+		}
+		void ClearStarts(void* p,size_t s){
+			for(size_t i=Bit(p),end=Bit((char*)p+s);i<end;){
+				size_t n=mark_bits-i%mark_bits;
+				if(n>end-i)
+					n=end-i;
+				m_starts[i/mark_bits]&=~((n==mark_bits?~(uintptr_t)0:((uintptr_t)1<<n)-1)<<(i%mark_bits));
+				i+=n;
+			}
+		}
+		// the closest term that starts at or below p, within one word of the bitmap
+		Term* FindStart(void* p){
+			size_t i=Bit(p);
+			uintptr_t w=m_starts[i/mark_bits]&(~(uintptr_t)0>>(mark_bits-1-i%mark_bits));
+			return w?(Term*)((char*)this+(i-i%mark_bits+mark_bits-1-__builtin_clzl(w))*HEAP_ELEM_ALIGNMENT):NULL;
+		}
 	private:
+		size_t Bit(void* p){return ((uintptr_t)p-(uintptr_t)this)/HEAP_ELEM_ALIGNMENT;}
+		static size_t Index(void* p){return (uintptr_t)p/Config::macroblock_size;}
+		static const size_t mark_bits=sizeof(uintptr_t)*8;
+		static const size_t marks=Config::macroblock_size/HEAP_ELEM_ALIGNMENT/mark_bits;
+		static const size_t starts=Config::gc_type==Config::gc_conservative?marks:0;
+		static const size_t owners=(size_t)((sizeof(void*)>4?(uint64_t)1<<47:(uint64_t)1<<32)/Config::macroblock_size);
+		static unsigned char* m_owners;
 		MacroBlock* m_next;
-		char buf[sizeof(HeapElement)+Config::macroblock_size] __attribute__((aligned(HEAP_ELEM_ALIGNMENT)));
+		uintptr_t m_marks[marks];
+		uintptr_t m_starts[starts];
+		char buf[Config::macroblock_size-HEAP_SIZE_ROUND_UP(sizeof(MacroBlock*)+sizeof(uintptr_t)*(marks+starts))] __attribute__((aligned(HEAP_ELEM_ALIGNMENT)));
 	} __attribute__((aligned(HEAP_ELEM_ALIGNMENT)));
+
+	unsigned char* MacroBlock::m_owners=NULL;
 	
+	////////////////////////////////////
+	// Nursery
+
+	// local terms are bump-allocated in the nursery
+	template <typename T> struct heap_nursery { enum { value = true }; };
+	template <typename T> struct heap_nursery<Global<T> > { enum { value = false }; };
+	template <> struct heap_nursery<NoTerm> { enum { value = false }; };
+
+	// terms of which the destructor does not have to be called when they die in the nursery
+	template <typename T> struct heap_trivial { enum { value = false }; };
+	template <> struct heap_trivial<Application> { enum { value = true }; };
+	template <> struct heap_trivial<Blackhole> { enum { value = true }; };
+	template <> struct heap_trivial<Constant<lcint_t> > { enum { value = true }; };
+	template <> struct heap_trivial<Constant<lcfloat_t> > { enum { value = true }; };
+	template <> struct heap_trivial<Constant<lccomplex_t> > { enum { value = true }; };
+
+	struct NurseryChunk {
+		NurseryChunk(char* start=NULL,char* end=NULL) : start(start), end(end) {}
+		char* start;
+		char* end;
+	};
+
+	////////////////////////////////////
+	// Slabs
+
+	// local terms of up to heap_size_classes alignment steps get a pool of slabs per size and per
+	// destructor kind, so they do not carry a header; the size and liveness come from the slab
+	template <typename T> struct heap_slab { enum { pool =
+		heap_nursery<T>::value&&sizeof(T)<=Config::heap_size_classes*HEAP_ELEM_ALIGNMENT?
+		(int)(HEAP_SIZE_ROUND_UP(sizeof(T))/HEAP_ELEM_ALIGNMENT-1)*2+(heap_trivial<T>::value?1:0) : -1 }; };
+	template <> struct heap_slab<NoTerm> { enum { pool = -1 }; };
+	enum { heap_slab_pools = Config::heap_size_classes*2 };
+
+	// A slab lives in the buffer of a heap element of Config::heap_slab_size bytes, and holds
+	// terms of one size, which are addressed by their index in the allocation bitmap.
+	class Slab {
+	public:
+		static const size_t bits=sizeof(uintptr_t)*8;
+		static const size_t words=Config::heap_slab_size/HEAP_ELEM_ALIGNMENT/bits+1;
+		Slab(size_t stride,bool trivial) : m_next(NULL), m_stride(stride), m_used(), m_hint(), m_young(), m_trivial(trivial) {
+			m_count=(Config::heap_slab_size-sizeof(HeapElement)-HEAP_SIZE_ROUND_UP(sizeof(Slab)))/stride;
+			memset(m_alloc,0,sizeof(m_alloc));
+		}
+		void* Alloc(){
+			for(size_t w=m_hint;w<words;w++){
+				uintptr_t free=~m_alloc[w];
+				if(free){
+					size_t i=w*bits+__builtin_ctzl(free);
+					if(i>=m_count)
+						break;
+					m_alloc[w]|=free&-free;
+					m_hint=w;
+					m_used++;
+					m_young=true;
+					return Object(i);
+				}
+			}
+			m_hint=words;
+			return NULL;
+		}
+		void Free(size_t i){
+#ifdef LAMBDA_DEBUG
+			memset(Object(i),0xe0,m_stride);
+#endif
+			VALGRIND_MAKE_MEM_UNDEFINED(Object(i),m_stride);
+			if(Config::gc_type==Config::gc_conservative)
+				MacroBlock::Of(Object(i))->ClearStarts(Object(i),m_stride);
+			m_alloc[i/bits]&=~((uintptr_t)1<<(i%bits));
+			m_used--;
+			if(i/bits<m_hint)
+				m_hint=i/bits;
+		}
+		Term* Object(size_t i){return (Term*)&m_objects[i*m_stride];}
+		uintptr_t Allocated(size_t w){return m_alloc[w];}
+		HeapElement* Element(){return (HeapElement*)((char*)this-sizeof(HeapElement));}
+		Slab* GetNext(){return m_next;}
+		void SetNext(Slab* next){m_next=next;}
+		size_t Stride(){return m_stride;}
+		bool IsFull(){return m_used==m_count;}
+		bool IsEmpty(){return m_used==0;}
+		size_t Used(){return m_used;}
+		bool IsTrivial(){return m_trivial;}
+		// terms have been allocated since the last GC
+		bool IsYoung(){return m_young;}
+		void SetYoung(bool young){m_young=young;}
+	private:
+		Slab* m_next;
+		size_t m_stride;
+		size_t m_count;
+		size_t m_used;
+		size_t m_hint;
+		bool m_young;
+		bool m_trivial;
+		uintptr_t m_alloc[words];
+		char m_objects[] __attribute__((aligned(HEAP_ELEM_ALIGNMENT)));
+	};
+
+	struct SlabPool {
+		SlabPool() : head(), cur(), tail() {}
+		Slab* head;
+		Slab* cur;
+		Slab* tail;
+	};
+
 	////////////////////////////////////
 	// Mark-sweep GC heap
 
 	template <>
 	class Heap<Config::gc_mark_sweep> {
 	public:
-		Heap() : m_mbs(NULL), m_free(), m_local(), m_global(), m_other(), m_marking() {}
+		Heap() : m_mbs(NULL), m_free(), m_local(), m_global(), m_other(), m_marking(), m_evaluating(), m_reducing(), m_census(), m_class(), m_class_size(),
+			m_bump(NULL), m_bump_start(NULL), m_bump_end(NULL), m_chunks(), m_chunk_count(), m_gaps(), m_nursery_full(),
+			m_remembered(), m_minor_gcs(), m_grey(), m_marked_all(true), m_sweep_local(), m_sweep_global(), m_swept(), m_release(),
+			m_heap(), m_used(), m_live(), m_global_size(), m_global_limit(Config::gc_global_min), m_slabs(), m_slab_sweeps(), m_other_class() {}
 		~Heap(){
+#ifdef HAVE_MMAP
+			for(HeapElementList::Iterator &it=m_large.iterate();*it;){
+				HeapElement* e=it.drop();
+				global_munmap(e,e->Sizeof());
+			}
+#endif
 			MacroBlock* m=m_mbs,*n;
 			while(m){
 				n=m->GetNext();
@@ -319,70 +771,222 @@ namespace lambda {
 		}
 		template <typename T> void* Alloc(size_t s){
 			LAMBDA_ASSERT(sizeof(T)==s||(is_type<T,NoTerm>::value),"allocing %lu bytes for a type of %lu bytes",s,sizeof(T));
-			LAMBDA_ASSERT(s<sizeof(MacroBlock)/2,"MacroBlock too small to allocate %lu bytes",s);
 #ifdef LAMBDA_DEBUG
 			worker_check_stack();
 #endif
+			if(is_type<T,NoTerm>::value)
+				return AllocOther(s);
+			Census<>::Type<T>(s);
+			LAMBDA_ASSERT(s<sizeof(MacroBlock)/2,"MacroBlock too small to allocate %lu bytes",s);
+			HeapElement* e=NULL;
 
-			HeapElementList::Iterator& it=m_free.getIterator();
-			while(true){
-				if(unlikely(!it.cur())){
-					LAMBDA_PRINT(mem,"cannot allocate %lu bytes for %s, try GC",s,typeid(T).name());
-					if(worker_inspect_state()||DoGC(true)){
-						// got much memory back
-						m_free.iterate();
-					}else{
-						LAMBDA_PRINT(mem,"really need more memory");
-						AllocMB();
-					}
-				}else if(likely(it.cur()->Size()>=s)){
-					// right size, use this one
-					HeapElement* e=it.use(s);
-					void* res=e->Buf();
-					if(likely((!is_type<T,NoTerm>::value))){
+			if(heap_slab<T>::pool>=0&&Config::heap_slab_size>0){
+				Slab* sl=m_slabs[heap_slab<T>::pool].cur;
+				void* res;
+				if(unlikely(!sl||!(res=sl->Alloc())))
+					res=SlabGrow(heap_slab<T>::pool,HEAP_SIZE_ROUND_UP(s),heap_trivial<T>::value);
+				m_used+=HEAP_SIZE_ROUND_UP(s);
+				LAMBDA_PRINT(mem,"allocated slab mem for %s@%p",typeid(T).name(),res);
+				VALGRIND_MAKE_MEM_UNDEFINED(res,s);
+				Started(res);
+				return res;
+			}
+
+			// locals are bumped from the nursery
+			if(heap_nursery<T>::value&&Config::nursery_chunk_size>0)
+				do{
+					size_t es=sizeof(HeapElement)+HEAP_SIZE_ROUND_UP(s);
+					if(likely(m_bump+es<=m_bump_end)){
+						size_t left=m_bump_end-m_bump-es;
+						if(left<sizeof(HeapElement)+HEAP_ELEM_ALIGNMENT)
+							es+=left;
+						e=new(m_bump) HeapElement(es);
+						m_bump+=es;
+						e->SetNext(NurseryTag(heap_trivial<T>::value));
+						void* res=e->Buf();
 						e->SetTerm(static_cast<Term*>(reinterpret_cast<T*>(res)));
-						m_new.insert(e);
-						LAMBDA_PRINT(mem,"allocated mem for %s@%p, &Term=%p",typeid(T).name(),res,e->GetTerm());
-					}else{
-						e->SetTerm((Term*)(uintptr_t)1);
-						m_other.insert(e);
-						LAMBDA_PRINT(mem,"allocated mem for other %p, size %lu",res,s);
+						LAMBDA_PRINT(mem,"allocated nursery mem for %s@%p",typeid(T).name(),res);
+						VALGRIND_MAKE_MEM_UNDEFINED(res,s);
+						Started(res);
+						return res;
 					}
-					VALGRIND_MAKE_MEM_UNDEFINED(res,s);
-					return res;
-				}else
-					it++;
+				}while(!m_nursery_full&&NurseryGrow());
+
+			// terms are served from the size class lists first
+			e=PopClass(s);
+			if(unlikely(!e))
+				e=Fit(s,true);
+
+			m_used+=e->Sizeof();
+			void* res=e->Buf();
+			e->SetTerm(static_cast<Term*>(reinterpret_cast<T*>(res)));
+			m_new.push(e);
+			LAMBDA_PRINT(mem,"allocated mem for %s@%p, &Term=%p",typeid(T).name(),res,e->GetTerm());
+			VALGRIND_MAKE_MEM_UNDEFINED(res,s);
+			Started(res);
+			return res;
+		}
+
+		// take s bytes from the free index, collect or grow the heap when it runs out
+		HeapElement* Fit(size_t s,bool is_term){
+			HeapElement* e;
+			for(bool rewound=false;!(e=m_free.fit(s));){
+				// finish the last GC first, which might give the right size back
+				bool swept=Config::gc_lazy_sweep&&Sweeping();
+				if(swept&&LazySweep()){
+					if(is_term&&(e=PopClass(s)))
+						break;
+					m_free.rewind();
+					continue;
+				}
+				if(is_term&&(e=PopClass(s,true)))
+					break;
+				// the search started at the cursor, try the elements before it too
+				if(!rewound){
+					rewound=true;
+					m_free.rewind();
+					continue;
+				}
+				if(m_heap<m_live*Config::gc_heap_growth){
+					LAMBDA_PRINT(mem,"heap of %lu bytes is below its target, grow",m_heap);
+					AllocMB();
+					continue;
+				}
+				LAMBDA_PRINT(mem,"cannot allocate %lu bytes, try GC",s);
+				if(!swept&&(worker_inspect_state()||DoGC(true))){
+					// got much memory back
+					if(is_term&&(e=PopClass(s)))
+						break;
+					m_free.rewind();
+				}else if(m_class_size>Config::macroblock_size/2){
+					LAMBDA_PRINT(mem,"coalesce size classes");
+					Coalesce();
+				}else{
+					LAMBDA_PRINT(mem,"really need more memory");
+					AllocMB();
+				}
+			}
+			return e;
+		}
+
+		static bool IsMarked(Term* t){return MacroBlock::Of(t)->IsMarked(t);}
+		static void Mark(Term* t){MacroBlock::Of(t)->Mark(t);}
+		static void Unmark(Term* t){MacroBlock::Of(t)->Unmark(t);}
+
+		// t is tenured, but might point to a young term now
+		void Remember(Term* t){
+			m_remembered.push(t);
+		}
+
+		////////////////////////////////////
+		// Incremental global GC
+		//
+		// A global GC starts with a short pause, in which every worker collects its locals
+		// and takes the globals they refer to as grey. Then, the globals are marked in small
+		// steps in between evaluation. Globals that are overwritten meanwhile have their old
+		// references marked too (snapshot-at-the-beginning), and new globals are alive.
+		// When all workers ran out of grey globals, a second pause finishes marking and
+		// sweeps the globals.
+
+		static bool IsMarking(){return Config::gc_incremental&&m_incremental.flush();}
+		// the references of global t are about to be overwritten
+		void Snapshot(Term* t){
+			t->References(m_grey);
+		}
+		// returns true when there is more to mark
+		bool MarkStep(){
+			if(!IsMarking())
+				return false;
+			Term* t;
+			for(unsigned int i=0;i<Config::gc_incremental_step&&(t=m_grey.pop());i++){
+				LAMBDA_VALIDATE_TERM(*t);
+				Count(t);
+				t->MarkActive(m_grey);
+			}
+			if(m_grey.peek())
+				return true;
+			if(!m_marked_all){
+				m_marked_all=true;
+				if(atomic_add(const_cast<int*>(&m_marking_workers),-1)==0)
+					gc_marking_done();
 			}
+			return false;
 		}
 
 		void Free(void* p){
 			if(p){
 				HeapElement* e=(HeapElement*)((uintptr_t)p-sizeof(HeapElement));
-				LAMBDA_ASSERT((uintptr_t)e->GetTerm()==(uintptr_t)1,"double or invalid free of %p",p);
+				LAMBDA_ASSERT(e->GetTerm()==OtherTag(false)||e->GetTerm()==OtherTag(true),"double or invalid free of %p",p);
 				e->SetTerm(NULL);
 				LAMBDA_PRINT(mem,"not really freeing %p, wait for GC",p);
 				VALGRIND_MAKE_MEM_NOACCESS(p,e->Size());
 			}
 		}
 		
+		// grow NoTerm p in place if possible
+		void* Realloc(void* p,size_t old_s,size_t new_s){
+			HeapElement* e=(HeapElement*)((uintptr_t)p-sizeof(HeapElement));
+			if(new_s<=e->Size()){
+				LAMBDA_PRINT(mem,"grow other %p in place to %lu bytes",p,new_s);
+				return p;
+			}
+#ifdef HAVE_MMAP
+			if(e->GetTerm()==OtherTag(true)&&global_mremap(e,e->Sizeof(),LargeSize(new_s))){
+				LAMBDA_PRINT(mem,"grow large other %p in place to %lu bytes",p,new_s);
+				e->Resize(LargeSize(new_s));
+				return p;
+			}
+#endif
+			void* res=AllocOther(new_s);
+			memcpy(res,p,old_s);
+			Free(p);
+			return res;
+		}
+		
 		bool DoGC(bool only_local){
-			if(only_local&&m_new.isEmpty()&&m_local.isEmpty())
+			SweepAll();
+			if(only_local&&m_new.isEmpty()&&m_local.isEmpty()&&!m_bump&&!m_chunk_count&&!HasSlabs())
 				return false;//nothing to collect
+			if(!only_local&&IsMarking())
+				return FinishMarking();
+			unsigned long long int pause=only_local?0:Stats<>::Now();
+
+			// only collect the young locals, except for every n-th local GC, or when the nursery got stuck
+			bool minor=only_local&&!m_nursery_full&&++m_minor_gcs<Config::local_gc_full_interval;
+			if(!minor)
+				m_minor_gcs=0;
 
-			LAMBDA_PRINT(gc,"Start %s GC...",only_local?"local":"global");
+			LAMBDA_PRINT(gc,"Start %s GC...",minor?"minor":only_local?"local":"global");
+			// don't ask for another global GC before this one has been swept
+			if(!only_local)
+				m_global_limit=~(size_t)0;
 			VCDDump<>::state_t vcd_old=worker_set_vcd(only_local?VCDDump<>::local_gc:VCDDump<>::global_gc);
 			size_t total_free=0;
 
-			if(!only_local){
+			if(!only_local&&Config::gc_incremental){
+				// the globals are old already, just take the grey roots
 				globalize_flushall();
-				if(gc_barrier_wait(true))
-					LAMBDA_PRINT(gc_details,"marking all globals old...");
-				// unmark all globals
-				for(HeapElementList::Iterator &it=m_global.iterate();*it;it++)
-					it.cur()->GetTerm()->MarkOld();
-				// and all possibly new globals
-				for(HeapElementList::Iterator &it=m_new.iterate();*it;it++)
-					it.cur()->GetTerm()->MarkOld();
+				if(gc_barrier_wait()){
+					LAMBDA_PRINT(gc_details,"start incremental marking...");
+					if(gc_marking_start()){
+						m_marking_workers=Config::workers;
+						m_incremental=true;
+					}
+					queue_mark_active(m_grey);
+				}
+				ClearMarks();
+				ScanRoots(m_marking,false);
+				globalize_flushall();
+				gc_barrier_wait();
+				m_marked_all=!IsMarking();
+			}else if(!only_local){
+				globalize_flushall();
+				if(gc_barrier_wait(true)){
+					LAMBDA_PRINT(gc_details,"unmarking all globals...");
+					gc_mark_reset();
+				}
+				ClearMarks();
+				ScanRoots(m_marking,false);
 				globalize_flushall();
 				if(gc_barrier_wait()){
 					LAMBDA_PRINT(gc_details,"marking all active terms and cleaning locals...");
@@ -390,45 +994,68 @@ namespace lambda {
 				}
 			}
 
+			Term *t;
+			if(minor)
+				// tenured terms that have been written to are roots, the others are assumed to be alive
+				m_remembered.dup(m_marking);
+			else
+				// all terms are traversed anyway
+				while((t=m_remembered.pop()))
+					t->Forget();
+
 			// mark reachables from roots
-			for(Term_tptr* p=term_stack;p;p=p->peek()){
-				Term* t=p->ptr();
-				LAMBDA_PRINT(gc_details,"Root: %p -> %p",p,t);
+			if(only_local)
+				ScanRoots(m_marking,true);
+			for(term_roots r;r.next(t);){
+				LAMBDA_PRINT(gc_details,"Root: %p",t);
 				if(t)
 					m_marking.push(t);
 			}
-			// mark all terms that are under evaluation
-			worker_eval_stack().dup(m_marking);
+			// mark all terms that are under evaluation, and prevent collapsing their applications
+			worker_eval_stack().dup(m_evaluating);
+			while((t=m_evaluating.pop())){
+				Application::MarkReducing(t,m_reducing);
+				m_marking.push(t);
+			}
 			// mark all terms that are followed by dot
 			dot_marked(m_marking);
 			// mark alive
 			LAMBDA_PRINT(gc_details,"marking...");
-			Term *t;
-			while((t=m_marking.pop())){
-				LAMBDA_VALIDATE_TERM(*t);
-				t->MarkActive(m_marking);
-			}
-
-			// clean dead locals
-			for(HeapElementList::Iterator &it_local=m_local.iterate(),&it_free=m_free.iterate();*it_local;){
-				HeapElement* e=it_local.cur();
-				Term* t=e->GetTerm();
-				LAMBDA_ASSERT(t!=NULL,"element %p does not point to a term",e);
-				LAMBDA_ASSERT(!t->IsGlobal(),"global %s on local list",t->name().c_str());
-				if(t->IsAlive()){
-					LAMBDA_PRINT(gc_details,"local %p is still alive",t);
-					t->MarkOld();
-					it_local++;
-				}else{
-					LAMBDA_PRINT(gc_details,"local %p is dead",t);
-					t->~Term();
-					total_free+=e->Size();
-					it_free.merge(it_local.drop()->thrash());
+			// only a stop-the-world global GC traverses the globals here
+			bool globals=!only_local&&!Config::gc_incremental;
+			unsigned int marked=0;
+			do{
+				while((t=m_marking.pop())){
+					LAMBDA_VALIDATE_TERM(*t);
+					if(minor&&t->IsTenured()&&!t->IsRemembered())
+						continue;
+					if(!globals&&t->IsGlobal()){
+						// globals never point to locals, leave them to the (incremental) global GC
+						if(!only_local)
+							m_grey.push(t);
+						continue;
+					}
+					Count(t);
+					t->MarkActive(m_marking);
+					// hand out part of the global graph to idle workers
+					if(globals&&Config::gc_mark_packet_size>0&&++marked%Config::gc_mark_packet_size==0)
+						gc_mark_share(m_marking);
 				}
-			}
-		
+			}while(globals&&gc_mark_steal(m_marking));
+			Application* a;
+			while((a=m_reducing.pop()))
+				a->UnmarkReducing();
+
+			// clean dead tenured locals
+			if(!minor)
+				total_free+=SweepOrDefer(m_local,m_sweep_local);
+
+			// clean nursery and slabs
+			total_free+=NurserySweep();
+			total_free+=SlabSweep(minor);
+
 			// check new elements
-			for(HeapElementList::Iterator &it_new=m_new.iterate(),&it_local=m_local.iterate(),&it_global=m_global.iterate(),&it_free=m_free.iterate();*it_new;){
+			for(HeapElementList::Iterator &it_new=m_new.iterate();*it_new;){
 				HeapElement* e=it_new.cur();
 				Term* t=e->GetTerm();
 				LAMBDA_ASSERT(t!=NULL,"element %p does not point to a term",e);
@@ -437,89 +1064,794 @@ namespace lambda {
 					it_new++;
 				}else if(t->IsGlobal()){
 					LAMBDA_PRINT(gc_details,"new %p is global and assumed to be alive",t);
-					it_global.insert(it_new.drop());
+					if(IsMarking()&&only_local)
+						// allocated during incremental marking
+						t->MarkAllocated();
+					else if(IsMarking())
+						// allocated before the snapshot, so it has to be traversed
+						m_grey.push(t);
+					m_global_size+=e->Sizeof();
+					m_global.push(it_new.drop());
 				}else if(t->IsAlive()){
 					LAMBDA_PRINT(gc_details,"new %p is local and alive",t);
-					it_local.insert(it_new.drop());
+					m_local.push(it_new.drop());
 					t->MarkOld();
+					t->MarkTenured();
 				}else{
 					LAMBDA_PRINT(gc_details,"new %p is local and dead",t);
 					t->~Term();
-					total_free+=e->Size();
-					it_free.merge(it_new.drop()->thrash());
+					total_free+=e->Sizeof();
+					Release(it_new.drop());
 				}
 			}
 
-			if(!only_local){
+			// the globals grew too much since the last global GC
+			if(only_local&&m_global_size>m_global_limit)
+				gc_request_global();
+
+			// no marking started, e.g. during shutdown
+			if(!only_local&&Config::gc_incremental&&!IsMarking())
+				while(m_grey.pop());
+
+			// all young survivors are tenured now, so there are no pointers from old to young anymore
+			while((t=m_remembered.pop())){
+				t->Forget();
+				// otherwise, the term is tenured and unmarked by the (lazy) sweep of the locals
+				if(minor)
+					t->MarkOld();
+			}
+
+			if(!only_local&&!Config::gc_incremental){
 				globalize_flushall();
 				if(gc_barrier_wait())
 					LAMBDA_PRINT(gc_details,"cleaning globals...");
-				// clean globals
-				for(HeapElementList::Iterator &it_global=m_global.iterate(),&it_free=m_free.iterate();*it_global;){
-					HeapElement* e=it_global.cur();
-					Term* t=e->GetTerm();
-					LAMBDA_ASSERT(t!=NULL,"element %p does not point to a term",e);
-					LAMBDA_ASSERT(t->IsGlobal(),"local %s on global list",t->name().c_str());
-					if(t->IsAlive()){
-						LAMBDA_PRINT(gc_details,"global %p is still alive",t);
-						t->MarkOld();
-						it_global++;
-					}else{
-						LAMBDA_PRINT(gc_details,"global %p is dead",t);
-						t->~Term();
-						total_free+=e->Size();
-						it_free.merge(it_global.drop()->thrash());
-					}
+				Evacuate();
+				total_free+=SweepOrDefer(m_global,m_sweep_global);
+				// a lazy sweep only touches dead globals, so there is no need to wait for the others
+				if(!Config::gc_lazy_sweep){
+					globalize_flushall();
+					if(gc_barrier_wait())
+						LAMBDA_PRINT(gc_details,"global GC done");
 				}
-				globalize_flushall();
-				if(gc_barrier_wait())
-					LAMBDA_PRINT(gc_details,"global GC done");
 			}
 
 			// clean NoTerms
-			for(HeapElementList::Iterator &it_other=m_other.iterate(),&it_free=m_free.iterate();*it_other;){
+			for(HeapElementList::Iterator &it_other=m_other.iterate();*it_other;){
 				HeapElement* e=it_other.cur();
 				if((uintptr_t)e->GetTerm()==(uintptr_t)0){
 					LAMBDA_PRINT(gc_details,"other %p is dead",e->Buf());
-					VALGRIND_MAKE_MEM_UNDEFINED(e->Buf(),e->Size());
-					total_free+=e->Size();
-					it_free.merge(it_other.drop()->thrash());
-				}else
+					total_free+=e->Sizeof();
+					ReleaseOther(it_other.drop());
+				}else{
+					m_census.Other(e->Sizeof());
 					it_other++;
+				}
+			}
+#ifdef HAVE_MMAP
+			for(HeapElementList::Iterator &it_large=m_large.iterate();*it_large;){
+				HeapElement* e=it_large.cur();
+				if((uintptr_t)e->GetTerm()==(uintptr_t)0){
+					LAMBDA_PRINT(gc_details,"large other %p is dead",e->Buf());
+					it_large.drop();
+					global_munmap(e,e->Sizeof());
+				}else{
+					m_census.Other(e->Sizeof());
+					it_large++;
+				}
+			}
+#endif
+
+			m_used-=total_free;
+			m_live=m_used;
+			if(!only_local&&!Config::gc_incremental){
+				m_release=true;
+				if(!Sweeping())
+					GlobalSwept();
 			}
 
 			// done
 			LAMBDA_PRINT(gc,"GC done, free=%d, new=%d, local=%d, global=%d, other=%d",m_free.size(),m_new.size(),m_local.size(),m_global.size(),m_other.size());
 			LAMBDA_PRINT(mem,"GC freed > %lu bytes",total_free);
+			m_census.Dump(minor?"minor":only_local?"local":"global");
 			worker_set_vcd(vcd_old);
-			return total_free>Config::macroblock_size/2;
+			if(!only_local)
+				Stats<>::Pause(pause);
+			if(minor&&total_free<=Config::macroblock_size/2){
+				// the young generation did not give enough, try the tenured locals before growing the heap
+				m_minor_gcs=Config::local_gc_full_interval;
+				return DoGC(true);
+			}
+			m_swept=total_free;
+			return total_free>Config::macroblock_size/2||Sweeping();
+		}
+		////////////////////////////////////
+		// Spark regions
+		//
+		// A worker that finished a spark holds no locals anymore: the result of the spark has
+		// been globalized, and globals never point to locals. So, all local memory of the spark
+		// is given back at once, without marking; only terms with a destructor are visited.
+
+		void DropLocals(){
+			SweepAll();
+#ifdef LAMBDA_DEBUG
+			Term* t;
+			for(term_roots r;r.next(t);)
+				LAMBDA_ASSERT(!t||t->IsGlobal(),"local %p is still referenced after a spark",t);
+#endif
+			LAMBDA_PRINT(gc,"drop the locals of the spark");
+			while(m_remembered.pop());
+			size_t total_free=0;
+			// the nursery chunks only hold terms that were allocated after the last GC
+			NurseryRetire();
+			m_nursery_full=false;
+			for(;m_chunk_count;m_chunk_count--){
+				NurseryChunk c=m_chunks.pop();
+				for(char* p=c.start;p<c.end;){
+					HeapElement* e=(HeapElement*)p;
+					p+=e->Sizeof();
+					if(e->Next()==NurseryTag(false))
+						e->GetTerm()->~Term();
+				}
+				total_free+=NurseryFree(c.start,c.end);
+			}
+			total_free+=SlabDrop();
+			for(HeapElementList::Iterator &it=m_local.iterate();*it;){
+				HeapElement* e=it.drop();
+				e->GetTerm()->~Term();
+				total_free+=e->Sizeof();
+				Release(e);
+			}
+			// the globals of the spark are kept
+			for(HeapElementList::Iterator &it_new=m_new.iterate();*it_new;){
+				HeapElement* e=it_new.cur();
+				Term* t=e->GetTerm();
+				if(!t->IsBorn()){
+					it_new++;
+				}else if(t->IsGlobal()){
+					if(IsMarking())
+						t->MarkAllocated();
+					m_global_size+=e->Sizeof();
+					m_global.push(it_new.drop());
+				}else{
+					t->~Term();
+					total_free+=e->Sizeof();
+					Release(it_new.drop());
+				}
+			}
+			m_used-=total_free;
+			LAMBDA_PRINT(mem,"spark region freed %lu bytes",total_free);
+			if(m_global_size>m_global_limit)
+				gc_request_global();
 		}
 	protected:
-		HeapElementList::Iterator& AllocMB(){
+		// second pause of the incremental global GC
+		bool FinishMarking(){
+			unsigned long long int pause=Stats<>::Now();
+			LAMBDA_PRINT(gc,"Finish global GC...");
+			VCDDump<>::state_t vcd_old=worker_set_vcd(VCDDump<>::global_gc);
+			globalize_flushall();
+			if(gc_barrier_wait(true))
+				LAMBDA_PRINT(gc_details,"marking remaining greys...");
+			unsigned int marked=0;
+			Term* t;
+			do{
+				while((t=m_grey.pop())){
+					LAMBDA_VALIDATE_TERM(*t);
+					Count(t);
+					t->MarkActive(m_grey);
+					if(Config::gc_mark_packet_size>0&&++marked%Config::gc_mark_packet_size==0)
+						gc_mark_share(m_grey);
+				}
+			}while(gc_mark_steal(m_grey));
+			globalize_flushall();
+			if(gc_barrier_wait()){
+				LAMBDA_PRINT(gc_details,"cleaning globals...");
+				// the mark pool is not in use until the next global GC
+				gc_mark_reset();
+				m_incremental=false;
+			}
+			size_t total_free=SweepOrDefer(m_global,m_sweep_global);
+			if(!Config::gc_lazy_sweep){
+				globalize_flushall();
+				if(gc_barrier_wait())
+					LAMBDA_PRINT(gc_details,"global GC done");
+			}
+			m_grey.cleanup();
+			m_used-=total_free;
+			m_live=m_used;
+			m_release=true;
+			if(!Sweeping())
+				GlobalSwept();
+			LAMBDA_PRINT(mem,"GC freed > %lu bytes",total_free);
+			m_census.Dump("global");
+			worker_set_vcd(vcd_old);
+			Stats<>::Pause(pause);
+			m_swept=total_free;
+			return total_free>Config::macroblock_size/2||Sweeping();
+		}
+		// a term that is about to be marked for the first time is alive
+		void Count(Term* t){
+			if(Config::gc_census&&t->IsBorn()&&!t->IsActive())
+				m_census.Count(typeid(*t),t->Site());
+		}
+		// unmark all terms in this worker's macroblocks, the locals are unmarked already
+		void ClearMarks(){
+			for(MacroBlock* m=m_mbs;m;m=m->GetNext())
+				m->ClearMarks();
+		}
+		////////////////////////////////////
+		// Conservative roots
+		//
+		// With gc_conservative, pointers on the stack are plain pointers. Instead, every word on
+		// the stack of the worker, in its registers, and in the static data, that points into an
+		// allocated term is taken as root. A global GC scans in between its first two barriers,
+		// when no worker frees terms, such that the terms of other workers can be checked too;
+		// of those, only the globals can be reached. A local GC only looks at its own terms.
+
+		static const bool conservative=Config::gc_type==Config::gc_conservative;
+		// p is allocated for a term; it is under construction as long as its vtable is NULL
+		static void Started(void* p){
+			if(conservative){
+				MacroBlock::Of(p)->SetStart(p);
+				*(void**)p=NULL;
+			}
+		}
+		void ScanRoots(Stack<Term*>& roots,bool only_local) __attribute__((noinline)){
+			if(!conservative)
+				return;
+			// spill the callee-saved registers into this frame
+			__builtin_unwind_init();
+			ScanStack(roots,only_local);
+#ifdef HAVE_DATA_SEGMENT
+			// the static data is the same for all workers, and only points to globals
+			if(!only_local&&worker_id()==0)
+				ScanRange(global_data_start,global_data_end,roots,false);
+#endif
+		}
+		void ScanStack(Stack<Term*>& roots,bool only_local) __attribute__((noinline)){
+			void* top=worker_stack_top();
+			void* sp=&top;
+			if(top)
+				ScanRange(sp<top?sp:top,sp<top?top:sp,roots,only_local);
+		}
+		void ScanRange(void* from,void* to,Stack<Term*>& roots,bool only_local){
+			int self=worker_id()+1;
+			unsigned int found=0;
+			for(void** p=(void**)(((uintptr_t)from+sizeof(void*)-1)&~(uintptr_t)(sizeof(void*)-1));(void*)p<to;p++){
+				void* w=*p;
+				int owner=MacroBlock::Owner(w);
+				if(!owner||(only_local&&owner!=self))
+					continue;
+				Term* t=MacroBlock::Of(w)->FindStart(w);
+				if(!t||!*(void**)t||(owner!=self&&!t->IsGlobal()))
+					continue;
+				LAMBDA_PRINT(gc_details,"Root: %p -> %p",p,t);
+				roots.push(t);
+				found++;
+			}
+			LAMBDA_PRINT(gc,"found %u conservative roots in %p-%p",found,from,to);
+		}
+		////////////////////////////////////
+		// Lazy sweeping
+		//
+		// With gc_lazy_sweep, a GC only takes the tenured locals and globals it has marked
+		// apart, and Alloc() sweeps them a few at a time when it runs out of free memory.
+		// The next GC finishes the sweep before marking again.
+
+		bool Sweeping(){return !m_sweep_local.isEmpty()||!m_sweep_global.isEmpty();}
+		// sweep all elements of l, or take them for a lazy sweep; returns the number of freed bytes
+		size_t SweepOrDefer(HeapElementList& l,HeapElementList& pending){
+			pending.take(l);
+			if(Config::gc_lazy_sweep)
+				return 0;
+			size_t n=~(size_t)0;
+			return Sweep(pending,l,n);
+		}
+		// sweep at most n elements of l and move the survivors to alive; returns the number of freed bytes
+		size_t Sweep(HeapElementList& l,HeapElementList& alive,size_t& n){
+			size_t total_free=0;
+			for(HeapElementList::Iterator &it=l.iterate();n&&*it;n--){
+				HeapElement* e=it.drop();
+				Term* t=e->GetTerm();
+				LAMBDA_ASSERT(t!=NULL,"element %p does not point to a term",e);
+				if(t->IsAlive()){
+					LAMBDA_PRINT(gc_details,"%p is still alive",t);
+					// globals keep their mark, it is cleared at the start of the next global GC
+					if(!t->IsGlobal())
+						t->MarkOld();
+					alive.push(e);
+				}else{
+					LAMBDA_PRINT(gc_details,"%p is dead",t);
+					if(t->IsGlobal())
+						m_global_size-=e->Sizeof();
+					t->~Term();
+					total_free+=e->Sizeof();
+					Release(e);
+				}
+			}
+			return total_free;
+		}
+		// returns false when the sweep is done, and the last GC did not give enough memory back
+		bool LazySweep(size_t n=Config::gc_lazy_sweep_step){
+			size_t freed=Sweep(m_sweep_local,m_local,n);
+			freed+=Sweep(m_sweep_global,m_global,n);
+			m_swept+=freed;
+			m_used-=freed;
+			if(Sweeping())
+				return true;
+			m_live=m_used;
+			// the nursery may find a chunk again
+			m_nursery_full=false;
+			LAMBDA_PRINT(mem,"lazy sweep done, GC freed > %lu bytes",m_swept);
+			if(m_release)
+				GlobalSwept();
+			return m_swept>Config::macroblock_size/2;
+		}
+		void SweepAll(){
+			if(Config::gc_lazy_sweep&&Sweeping())
+				LazySweep(~(size_t)0);
+		}
+		static size_t SizeClass(size_t s){return HEAP_SIZE_ROUND_UP(s)/HEAP_ELEM_ALIGNMENT;}
+		HeapElement* PopClass(size_t s,bool larger=false){
+			size_t c=SizeClass(s);
+			for(size_t end=larger?Config::heap_size_classes:c+1;c<end;c++){
+				HeapElement* e=m_class[c];
+				if(e){
+					m_class[c]=e->Next();
+					m_class_size-=e->Size();
+					return e;
+				}
+			}
+			return NULL;
+		}
+		// return a dead element to its size class, or to the general free list
+		void Release(HeapElement* e){
+			if(conservative)
+				MacroBlock::Of(e)->ClearStarts(e,e->Sizeof());
+			size_t c=e->Size()/HEAP_ELEM_ALIGNMENT;
+			e->thrash();
+			if(c<Config::heap_size_classes){
+				e->SetNext(m_class[c]);
+				m_class[c]=e;
+				m_class_size+=e->Size();
+			}else
+				m_free.merge(e);
+		}
+		// move all size classes back into the general free list
+		void Coalesce(){
+			HeapElement* chain=NULL;
+			for(size_t c=0;c<Config::heap_size_classes;c++){
+				HeapElement* e=m_class[c];
+				if(!e)
+					continue;
+				while(e->Next())
+					e=e->Next();
+				e->SetNext(chain);
+				chain=m_class[c];
+				m_class[c]=NULL;
+			}
+			for(size_t c=0;c<other_classes;c++){
+				HeapElement* e=m_other_class[c];
+				if(!e)
+					continue;
+				while(e->Next())
+					e=e->Next();
+				e->SetNext(chain);
+				chain=m_other_class[c];
+				m_other_class[c]=NULL;
+			}
+			m_class_size=0;
+			m_free.mergeAll(chain);
+		}
+		// m_next of nursery elements, which tells whether the destructor has to be called when the term dies
+		static HeapElement* NurseryTag(bool trivial){
+			return (HeapElement*)(uintptr_t)(trivial?3:2);
+		}
+		// take a recycled gap or a big free element as new nursery chunk
+		bool NurseryGrow(){
+			NurseryRetire();
+			NurseryChunk c=m_gaps.pop();
+			if(c.start){
+				m_bump=m_bump_start=c.start;
+				m_bump_end=c.end;
+				return true;
+			}
+			HeapElement* e=m_free.takeAtLeast(Config::nursery_chunk_size);
+			if(e){
+				m_bump=m_bump_start=(char*)e;
+				m_bump_end=m_bump+e->Sizeof();
+				LAMBDA_PRINT(mem,"new nursery chunk %p of size 0x%lx",m_bump,(unsigned long)(m_bump_end-m_bump));
+				return true;
+			}
+			// don't search again before the next GC or macroblock
+			m_nursery_full=true;
+			return false;
+		}
+		// stop bumping in the current chunk, and give back the unused tail
+		void NurseryRetire(){
+			if(!m_bump)
+				return;
+			m_used+=m_bump-m_bump_start;
+			if(m_bump<m_bump_end)
+				Release(new(m_bump) HeapElement(m_bump_end-m_bump));
+			if(m_bump>m_bump_start){
+				m_chunks.push(NurseryChunk(m_bump_start,m_bump));
+				m_chunk_count++;
+			}
+			m_bump=m_bump_start=m_bump_end=NULL;
+		}
+		// walk all nursery chunks, keep the survivors in place, and free the gaps in between; returns the number of freed bytes
+		size_t NurserySweep(){
+			NurseryRetire();
+			m_nursery_full=false;
+			// unused gaps are not part of any chunk, just give them back
+			for(NurseryChunk c;(c=m_gaps.pop()).start;)
+				Release(new(c.start) HeapElement(c.end-c.start));
+			size_t total_free=0;
+			for(;m_chunk_count;m_chunk_count--){
+				NurseryChunk c=m_chunks.pop();
+				char* gap=NULL;
+				for(char* p=c.start;p<c.end;){
+					HeapElement* e=(HeapElement*)p;
+					p+=e->Sizeof();
+					Term* t=e->GetTerm();
+					if(t->IsBorn()&&!t->IsAlive()){
+						LAMBDA_PRINT(gc_details,"nursery %p is dead",t);
+						if(e->Next()==NurseryTag(false))
+							t->~Term();
+						if(!gap)
+							gap=(char*)e;
+						continue;
+					}
+					if(gap){
+						total_free+=NurseryFree(gap,(char*)e);
+						gap=NULL;
+					}
+					if(!t->IsBorn()){
+						LAMBDA_PRINT(gc_details,"nursery %p is unborn, skipping",t);
+						m_new.push(e);
+					}else{
+						LAMBDA_PRINT(gc_details,"nursery %p is alive",t);
+						m_local.push(e);
+						t->MarkOld();
+						t->MarkTenured();
+					}
+				}
+				if(gap)
+					total_free+=NurseryFree(gap,c.end);
+			}
+			return total_free;
+		}
+		// big gaps are bumped into again, small ones are released
+		size_t NurseryFree(char* start,char* end){
+			if((size_t)(end-start)>=Config::nursery_gap_size){
+				if(conservative)
+					MacroBlock::Of(start)->ClearStarts(start,end-start);
+				(new(start) HeapElement(end-start))->thrash();
+				m_gaps.push(NurseryChunk(start,end));
+			}else
+				Release(new(start) HeapElement(end-start));
+			return end-start;
+		}
+		// the last global GC has been swept completely
+		void GlobalSwept(){
+			m_release=false;
+			m_global_limit=max(m_global_size*Config::gc_heap_growth,Config::gc_global_min);
+			ReleaseMacroBlocks();
+		}
+		// give the empty macroblocks beyond Config::macroblock_retain back to the OS, or those that are beyond the heap's target
+		void ReleaseMacroBlocks(){
+			// only whole free elements tell that a block is empty
+			NurseryRetire();
+			for(NurseryChunk c;(c=m_gaps.pop()).start;)
+				Release(new(c.start) HeapElement(c.end-c.start));
+			Coalesce();
+			size_t retained=0;
+			for(MacroBlock* m=m_mbs,*prev=NULL,*next;m;m=next){
+				next=m->GetNext();
+				HeapElement* e=m->Empty();
+				if(!e||retained++<Config::macroblock_retain||m_heap<m_live*Config::gc_heap_growth+Config::macroblock_size){
+					prev=m;
+				}else if(Config::macroblock_unmap){
+					LAMBDA_PRINT(mem,"unmap MacroBlock %p",m);
+					m_free.remove(e);
+					if(prev)
+						prev->SetNext(next);
+					else
+						m_mbs=next;
+					delete m;
+					m_heap-=Config::macroblock_size;
+					Stats<>::MacroblockReturned();
+				}else{
+					LAMBDA_PRINT(mem,"discard MacroBlock %p",m);
+					m->Discard();
+					prev=m;
+				}
+			}
+			m_free.rewind();
+		}
+		////////////////////////////////////
+		// NoTerms
+		//
+		// NoTerm blocks, like the limbs of GMP, are recycled in power-of-two classes of their own,
+		// such that they do not fragment the terms, and grow in place up to their class size.
+		// Blocks of at least Config::heap_noterm_large bytes are mapped separately, and are
+		// unmapped when they die.
+
+		static const size_t other_classes=sizeof(size_t)*8;
+		static const size_t other_class_min=5;
+		// the class of which the blocks hold at least s bytes
+		static size_t OtherClass(size_t s){return s<=((size_t)1<<other_class_min)?other_class_min:other_classes-__builtin_clzl(s-1);}
+		// m_term of allocated NoTerm elements
+		static Term* OtherTag(bool large){return (Term*)(uintptr_t)(large?2:1);}
+#ifdef HAVE_MMAP
+		static size_t LargeSize(size_t s){return (sizeof(HeapElement)+s+PAGE_SIZE_MIN-1)&~(size_t)(PAGE_SIZE_MIN-1);}
+#endif
+		void* AllocOther(size_t s){
+			HeapElement* e;
+#ifdef HAVE_MMAP
+			if(s>=Config::heap_noterm_large){
+				void* m=global_mmap(LargeSize(s));
+				if(!m)
+					Error("cannot map %lu bytes",s);
+				e=new(m) HeapElement(LargeSize(s));
+				e->SetTerm(OtherTag(true));
+				m_large.push(e);
+				LAMBDA_PRINT(mem,"mapped mem for large other %p, size %lu",e->Buf(),s);
+				return e->Buf();
+			}
+#endif
+			LAMBDA_ASSERT(s<sizeof(MacroBlock)/2,"MacroBlock too small to allocate %lu bytes",s);
+			size_t c=OtherClass(s);
+			if((e=m_other_class[c])){
+				m_other_class[c]=e->Next();
+				m_class_size-=e->Size();
+			}else
+				e=Fit((size_t)1<<c,false);
+			m_used+=e->Sizeof();
+			e->SetTerm(OtherTag(false));
+			m_other.push(e);
+			LAMBDA_PRINT(mem,"allocated mem for other %p, size %lu",e->Buf(),s);
+			VALGRIND_MAKE_MEM_UNDEFINED(e->Buf(),s);
+			return e->Buf();
+		}
+		// return a dead NoTerm element to the class of which it can hold all sizes
+		void ReleaseOther(HeapElement* e){
+			size_t c=other_classes-1-__builtin_clzl(e->Size());
+			e->thrash();
+			e->SetNext(m_other_class[c]);
+			m_other_class[c]=e;
+			m_class_size+=e->Size();
+		}
+		////////////////////////////////////
+		// Compaction
+		//
+		// A stop-the-world global GC moves live global applications that have not been reduced yet
+		// to the lowest free space that fits, and turns the old copy into an indirection to the new
+		// one. Applications skip such indirections when they are marked, so the old copy dies in one
+		// of the next global GCs, and the sparse macroblocks drain until they can be released.
+
+		// returns the number of moved bytes
+		size_t Evacuate(){
+			if(Config::gc_compact_size==0)
+				return 0;
+			Coalesce();
+			m_free.rewind();
+			const size_t s=sizeof(Global<Application>);
+			HeapElementList moved;
+			size_t n=0;
+			for(HeapElementList::Iterator &it=m_global.iterate();*it&&n<Config::gc_compact_size;it++){
+				HeapElement* e=it.cur();
+				Term* t=e->GetTerm();
+				if(typeid(*t)!=typeid(Global<Application>)||!t->IsActive()||&t->FollowIndirection()!=t)
+					continue;
+				HeapElement* c=m_free.fit(s);
+				if(!c)
+					break;
+				if((uintptr_t)c>(uintptr_t)e){
+					// no room below t
+					m_free.merge(c);
+					continue;
+				}
+				Term* copy=(Term*)c->Buf();
+				memcpy((void*)copy,(void*)t,s);
+				if(conservative)
+					MacroBlock::Of(copy)->SetStart(copy);
+				Mark(copy);
+				c->SetTerm(copy);
+				moved.push(c);
+				t->SetIndirection(copy);
+				LAMBDA_PRINT(gc_details,"evacuated %p to %p",t,copy);
+				n+=c->Sizeof();
+			}
+			for(HeapElementList::Iterator &it=moved.iterate();*it;)
+				m_global.push(it.drop());
+			m_global_size+=n;
+			m_used+=n;
+			m_free.rewind();
+			LAMBDA_PRINT(mem,"evacuated %lu bytes of globals",n);
+			return n;
+		}
+		////////////////////////////////////
+		// Slabs
+
+		bool HasSlabs(){
+			for(int p=0;p<heap_slab_pools;p++)
+				if(m_slabs[p].head)
+					return true;
+			return false;
+		}
+		// the current slab of the pool is full, continue in the next one with free space, or in a new one
+		void* SlabGrow(int p,size_t stride,bool trivial){
+			SlabPool& pool=m_slabs[p];
+			for(Slab* sl=pool.cur?pool.cur->GetNext():pool.head;sl;sl=sl->GetNext())
+				if(!sl->IsFull()){
+					pool.cur=sl;
+					return sl->Alloc();
+				}
+			size_t sweeps=m_slab_sweeps;
+			HeapElement* e=Fit(Config::heap_slab_size-sizeof(HeapElement),false);
+			e->SetTerm(NULL);
+			Slab* sl=new(e->Buf()) Slab(stride,trivial);
+			LAMBDA_PRINT(mem,"new slab %p for pool %d",sl,p);
+			if(pool.tail)
+				pool.tail->SetNext(sl);
+			else
+				pool.head=sl;
+			pool.tail=sl;
+			if(sweeps!=m_slab_sweeps&&pool.cur){
+				// a GC made room in the first slabs meanwhile
+				void* res=pool.cur->Alloc();
+				return res?res:SlabGrow(p,stride,trivial);
+			}
+			pool.cur=sl;
+			return sl->Alloc();
+		}
+		// give all slabs back, the terms in them are dead; returns the number of freed bytes
+		size_t SlabDrop(){
+			size_t total_free=0;
+			for(int p=0;p<heap_slab_pools;p++){
+				SlabPool& pool=m_slabs[p];
+				for(Slab* sl=pool.head,*next;sl;sl=next){
+					next=sl->GetNext();
+					if(!sl->IsTrivial())
+						for(size_t w=0;w<Slab::words;w++)
+							for(uintptr_t used=sl->Allocated(w);used;used&=used-1)
+								sl->Object(w*Slab::bits+__builtin_ctzl(used))->~Term();
+					total_free+=sl->Used()*sl->Stride();
+					Release(sl->Element());
+				}
+				pool=SlabPool();
+			}
+			return total_free;
+		}
+		// sweep the slabs like the nursery, but skip the tenured terms during a minor GC; returns the number of freed bytes
+		size_t SlabSweep(bool minor){
+			size_t total_free=0;
+			m_slab_sweeps++;
+			for(int p=0;p<heap_slab_pools;p++){
+				SlabPool& pool=m_slabs[p];
+				Slab* prev=NULL;
+				for(Slab* sl=pool.head,*next;sl;sl=next){
+					next=sl->GetNext();
+					if(minor&&!sl->IsYoung()){
+						prev=sl;
+						continue;
+					}
+					bool young=false;
+					for(size_t w=0;w<Slab::words;w++)
+						for(uintptr_t used=sl->Allocated(w);used;used&=used-1){
+							size_t i=w*Slab::bits+__builtin_ctzl(used);
+							Term* t=sl->Object(i);
+							if(!t->IsBorn()){
+								LAMBDA_PRINT(gc_details,"slab %p is unborn, skipping",t);
+								young=true;
+							}else if(minor&&t->IsTenured()){
+								// assumed to be alive
+							}else if(t->IsAlive()){
+								LAMBDA_PRINT(gc_details,"slab %p is alive",t);
+								t->MarkOld();
+								t->MarkTenured();
+							}else{
+								LAMBDA_PRINT(gc_details,"slab %p is dead",t);
+								if(!sl->IsTrivial())
+									t->~Term();
+								sl->Free(i);
+								total_free+=sl->Stride();
+							}
+						}
+					sl->SetYoung(young);
+					if(sl->IsEmpty()){
+						LAMBDA_PRINT(mem,"release empty slab %p",sl);
+						if(prev)
+							prev->SetNext(next);
+						else
+							pool.head=next;
+						Release(sl->Element());
+					}else
+						prev=sl;
+				}
+				pool.tail=prev;
+				// allocate from the first slabs again
+				pool.cur=pool.head;
+			}
+			return total_free;
+		}
+		void AllocMB(){
 			void* m=MacroBlock::Alloc(sizeof(MacroBlock));
 			if(!m){
 				m_marking.cleanup(); //try to free some more memory
 				worker_eval_stack().cleanup();
 				LAMBDA_PRINT(mem,"cannot allocate macroblock, try global GC");
-				if(!gc_trigger_global())
+				bool freed=gc_trigger_global();
+				// an incremental global GC has only started marking, finish it right away
+				if(!freed&&IsMarking())
+					freed=gc_trigger_global();
+				if(!freed)
 					Error("out of memory");
 				LAMBDA_PRINT(mem,"freed enough memory to continue without additional macroblock");
-				return m_free.iterate();
+				m_free.rewind();
 			}else{
 				m_mbs=new(m) MacroBlock(m_mbs);
+				m_heap+=Config::macroblock_size;
+				m_nursery_full=false;
 				Stats<>::Macroblock();
 				LAMBDA_PRINT(mem,"new MacroBlock %p of size 0x%lx",m_mbs,Config::macroblock_size);
-				return m_free.insert(m_mbs->Init());
+				m_free.merge(m_mbs->Init());
 			}
 		}
 	private:
 		MacroBlock* m_mbs;
-		HeapElementList m_free;
+		heap_free<Config::heap_free>::type m_free;
 		HeapElementList m_new;
 		HeapElementList m_local;
 		HeapElementList m_global;
 		HeapElementList m_other;
 		Stack<Term*> m_marking;
+		Stack<Term*> m_evaluating;
+		Stack<Application*> m_reducing;
+		Census<> m_census;
+		HeapElement* m_class[Config::heap_size_classes];
+		size_t m_class_size;
+		char* m_bump;
+		char* m_bump_start;
+		char* m_bump_end;
+		Stack<NurseryChunk> m_chunks;
+		size_t m_chunk_count;
+		Stack<NurseryChunk> m_gaps;
+		bool m_nursery_full;
+		Stack<Term*> m_remembered;
+		int m_minor_gcs;
+		Stack<Term*> m_grey;
+		bool m_marked_all;
+		HeapElementList m_sweep_local;
+		HeapElementList m_sweep_global;
+		size_t m_swept;
+		bool m_release;
+		size_t m_heap;
+		size_t m_used;
+		size_t m_live;
+		size_t m_global_size;
+		size_t m_global_limit;
+		SlabPool m_slabs[heap_slab_pools];
+		size_t m_slab_sweeps;
+		HeapElement* m_other_class[other_classes];
+		HeapElementList m_large;
+		static shared_t<bool>::type m_incremental;
+		static shared_t<int>::type m_marking_workers;
+	};
+
+	shared_t<bool>::type Heap<Config::gc_mark_sweep>::m_incremental(false);
+	shared_t<int>::type Heap<Config::gc_mark_sweep>::m_marking_workers(0);
+
+	////////////////////////////////////
+	// Conservative mark-sweep GC heap
+
+	// the mark-sweep heap takes the roots from the stack itself when Config::gc_type is gc_conservative
+	template <>
+	class Heap<Config::gc_conservative> : public Heap<Config::gc_mark_sweep> {
+	public:
+		Heap() : Heap<Config::gc_mark_sweep>() {MacroBlock::InitOwners();}
 	};
 };
 
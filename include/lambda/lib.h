@@ -37,7 +37,8 @@ namespace lambda {
 ////////////////////////////////////
 // Basics
 
-#ifdef LAMBDA_DEBUG
+// the census reports the allocating functions by their label
+#if defined(LAMBDA_DEBUG) || defined(LAMBDA_GC_CENSUS)
 #  define LAMBDA_FUNC_LABEL(f,arg...) STRINGIFY(f) STRINGIFY((arg))
 #else
 #  define LAMBDA_FUNC_LABEL(...) NULL
@@ -343,16 +344,22 @@ FUN(isNonZero,T expr){
 
 // makes sure op (a1) (a2) is called when a1 and a2 are expanded to constants
 FUN(primop,T op,T a1,T a2){
-	if(isReducable(a1))
-		return eagerApply (flip (primop (op)) (a2)) (a1);
-	else if(isReducable(a2))
-		return eagerApply (primop (op) (a1)) (a2);
-	else if(isFunction(a1))
-		return compose (flip (primop (op)) (a2)) (a1);
-	else if(isFunction(a2))
-		return compose (primop (op) (a1)) (a2);
+	T x1=a1.FollowFullIndirection();
+	T x2=a2.FollowFullIndirection();
+	if(isReducable(x1)||isReducable(x2)){
+		// force both operands in place (a1 first), and try again with their values
+		if(isReducable(x2))
+			eager (x2);
+		if(isReducable(x1))
+			eager (x1);
+		return primop (op) (x1) (x2);
+	}else if(isFunction(x1))
+		return compose (flip (primop (op)) (x2)) (x1);
+	else if(isFunction(x2))
+		return compose (primop (op) (x1)) (x2);
 	else
-		return op (a1) (a2);
+		// both are values already, so apply op right away instead of building op (x1) (x2) first
+		return op.ReduceApply(&x1,&x2);
 }
 
 FUN(blackhole_finish,T bh,T x){
@@ -1290,7 +1297,7 @@ static void print_config(){
 #ifdef HAVE_GMP
 			" gmp"
 #endif
-		"\n\tconfig: w=%d mb=%luKiB ggc=%dms%s%s%s%s%s%s%s",
+		"\n\tconfig: w=%d mb=%luKiB ggc=%dms%s%s%s%s%s%s%s%s",
 			Config::workers,
 			Config::macroblock_size/1024,
 			Config::global_gc_interval_ms,
@@ -1298,6 +1305,7 @@ static void print_config(){
 			Config::enable_assert?" assert":"",
 			Config::enable_dot?" dot":"",
 			Config::enable_vcd?" vcd":"",
+			Config::gc_census?" census":"",
 			Config::term_queue_atomic?" atomic_q":"",
 			Config::atomic_indir?" atomic_indir":"",
 			Config::interrupt_sleep?" intr":""
@@ -1318,6 +1326,9 @@ int main(int argc,char** argv){
 	globalize_flushall(); // don't know where the functions above will be stored
 #endif
 	platform_init();
+	// the conservative GC scans the stack up to main()'s frame, as the worker recorded a static constructor's
+	if(Config::gc_type==Config::gc_conservative)
+		current_worker->SetStackTop(__builtin_frame_address(0));
 
 	let stack_end=end;
 	let a=lambda::convargs(argc-1,argv+1);
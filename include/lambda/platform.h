@@ -32,6 +32,9 @@ along with lambda.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stddef.h>
 #include <stdlib.h>
+#if defined(LAMBDA_PLATFORM_x86) || defined(LAMBDA_PLATFORM_MAC)
+#  include <sys/mman.h>
+#endif
 
 namespace lambda {
 	
@@ -105,12 +108,36 @@ namespace lambda {
 #  define fence()						do{__sync_synchronize();asm volatile ("" : : : "memory");}while(0)
 #  define atomic_cas(ptr,oldval,newval)	__sync_val_compare_and_swap(ptr,oldval,newval)
 #  define atomic_add(ptr,val)			__sync_add_and_fetch(ptr,val)
+#  define atomic_or(ptr,val)			__sync_or_and_fetch(ptr,val)
+#  define atomic_and(ptr,val)			__sync_and_and_fetch(ptr,val)
 
 #  define global_malloc(size)	malloc(size)
 #  define global_free(ptr)		free(ptr)
 #  define local_malloc(size)	malloc(size)
 #  define local_free(ptr)		free(ptr)
 
+#  define HAVE_MMAP
+#  define global_mmap(size)				({void* p_=mmap(NULL,(size),PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANON,-1,0);p_==MAP_FAILED?NULL:p_;})
+#  define global_munmap(ptr,size)		munmap(ptr,size)
+#  define global_discard(ptr,size)		madvise(ptr,size,MADV_DONTNEED)
+#  ifdef MADV_HUGEPAGE
+#    define global_hugepage(ptr,size)	madvise(ptr,size,MADV_HUGEPAGE)
+#  else
+#    define global_hugepage(ptr,size)	0
+#  endif
+#  ifdef MREMAP_MAYMOVE
+#    define global_mremap(ptr,size,new_size)	(mremap(ptr,size,new_size,0)!=MAP_FAILED)
+#  else
+#    define global_mremap(ptr,size,new_size)	0
+#  endif
+#  define PAGE_SIZE_MIN					4096
+
+	// bounds of the static data, which is scanned for roots by the conservative GC
+	extern "C" char __data_start[],_end[];
+#  define HAVE_DATA_SEGMENT
+#  define global_data_start				((void*)__data_start)
+#  define global_data_end				((void*)_end)
+
 #  define globalize_mem(ptr,size)		ptr
 #  define globalize_dupmem(ptr,size)	({size_t s_=(size);cv_type<typeof(*ptr)>::type_nc* p_=(typeof(p_))global_malloc(s_);if(p_)memcpy(p_,ptr,s_);p_;})
 #  define globalize_flushmem(ptr,size)	fence()
@@ -202,6 +229,28 @@ namespace lambda {
 		return newval;
 	}
 
+	template <typename T>
+	static T atomic_or(T* ptr,T val){
+		mc_flush(*ptr);
+		auto_ret<bool,true>(lck_lock(ptr)<=0);
+		T newval=*ptr|val;
+		*ptr=newval;
+		mc_flush(*ptr);
+		lck_unlock(ptr);
+		return newval;
+	}
+
+	template <typename T>
+	static T atomic_and(T* ptr,T val){
+		mc_flush(*ptr);
+		auto_ret<bool,true>(lck_lock(ptr)<=0);
+		T newval=*ptr&val;
+		*ptr=newval;
+		mc_flush(*ptr);
+		lck_unlock(ptr);
+		return newval;
+	}
+
 extern "C" { int __register_exitproc(int,void*(void),void*,void*) __attribute__((weak)); }
 	static int platform_boot() __attribute__((optimize("1"))); // weak symbols and -O>1 are problematic, apparently
 	static int platform_boot(){
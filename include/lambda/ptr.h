@@ -43,7 +43,17 @@ namespace lambda {
 	DECL_THREAD_LOCAL_PTR(T_tptr<Term>*,term_stack)
 #define term_stack DECL_THREAD_LOCAL_PTR_NAME(term_stack,0)
 
-	template <typename T,Config::gc_type_t gc=Config::gc_type>
+	// shadow stack: the roots in one contiguous array, the first slot is a NULL sentinel
+	DECL_THREAD_LOCAL_PTR(Term**,shadow_base)
+#define shadow_base DECL_THREAD_LOCAL_PTR_NAME(shadow_base,2)
+	DECL_THREAD_LOCAL_PTR(Term**,shadow_top)
+#define shadow_top DECL_THREAD_LOCAL_PTR_NAME(shadow_top,3)
+	DECL_THREAD_LOCAL_PTR(Term**,shadow_end)
+#define shadow_end DECL_THREAD_LOCAL_PTR_NAME(shadow_end,4)
+	// a slot that has been popped while not being on top
+#define shadow_hole ((Term*)1)
+
+	template <typename T,Config::gc_type_t gc=Config::gc_type,bool shadow=(gc==Config::gc_mark_sweep&&Config::gc_shadow_stack)>
 	class T_stackable {
 	public:
 		T_stackable() LAMBDA_INLINE : m_prev(NULL) {}
@@ -83,6 +93,7 @@ namespace lambda {
 			p->m_prev=m_prev;
 			m_prev=p;
 		}
+		static void update(T* t) LAMBDA_INLINE {}
 	private:
 		T_tptr<T>* that() LAMBDA_INLINE { return static_cast<T_tptr<T>*>(this); }
 		T_tptr<T>* that() const LAMBDA_INLINE { return const_cast<T_tptr<T>*>(static_cast<const T_tptr<T>*>(this)); }
@@ -90,13 +101,70 @@ namespace lambda {
 	};
 
 	template <typename T>
-	class T_stackable<T,Config::gc_none> {
+	class T_stackable<T,Config::gc_none,false> {
 	public:
 		static T_tptr<T>* peek()		LAMBDA_INLINE { return NULL; }
 	protected:
 		static void push()				LAMBDA_INLINE {}
 		static void pop()				LAMBDA_INLINE {}
 		static void swap(T_tptr<T>* p)	LAMBDA_INLINE {}
+		static void update(T* t)		LAMBDA_INLINE {}
+	};
+
+	// the conservative GC finds the pointers on the stack itself
+	template <typename T>
+	class T_stackable<T,Config::gc_conservative,false> : public T_stackable<T,Config::gc_none,false> {};
+
+	// Every ptr owns a slot in the shadow stack, which holds a copy of its value. Pointers
+	// mostly die in reverse order; the others leave a hole, which is skipped by the scan
+	// and dropped as soon as the slots above it are popped.
+	template <typename T,Config::gc_type_t gc>
+	class T_stackable<T,gc,true> {
+	public:
+		T_stackable() LAMBDA_INLINE : m_slot(NULL) {}
+		~T_stackable() LAMBDA_INLINE {
+			if(likely(m_slot!=NULL))
+				pop();
+		}
+		// roots are not linked, use term_roots instead
+		static T_tptr<T>* peek() LAMBDA_INLINE { return NULL; }
+		void push() const LAMBDA_INLINE {
+			LAMBDA_ASSERT(m_slot==NULL,"doubly stacked ptr %p -> %p",that(),that()->ptr());
+			if(unlikely(shadow_top==shadow_end))
+				grow();
+			m_slot=shadow_top++;
+			*m_slot=that()->ptr();
+		}
+		void pop() const LAMBDA_INLINE {
+			if(likely(m_slot+1==shadow_top)){
+				Term** top=m_slot;
+				while(unlikely(top[-1]==shadow_hole))
+					top--;
+				shadow_top=top;
+			}else
+				*m_slot=shadow_hole;
+			m_slot=NULL;
+		}
+		void swap(T_tptr<T>* p) const LAMBDA_INLINE {
+			// the temporary will pop itself later on
+			p->push();
+		}
+		void update(T* t) const LAMBDA_INLINE {
+			if(m_slot)
+				*m_slot=t;
+		}
+	private:
+		static void grow() __attribute__((noinline)) {
+			if(shadow_base)
+				Error("shadow stack overflow");
+			if(!(shadow_base=(Term**)local_malloc(Config::gc_shadow_stack_size*sizeof(Term*))))
+				Error("cannot allocate shadow stack");
+			shadow_base[0]=NULL;
+			shadow_top=shadow_base+1;
+			shadow_end=shadow_base+Config::gc_shadow_stack_size;
+		}
+		T_tptr<T>* that() const LAMBDA_INLINE { return const_cast<T_tptr<T>*>(static_cast<const T_tptr<T>*>(this)); }
+		mutable Term** m_slot;
 	};
 	
 	////////////////////////////////////
@@ -142,7 +210,7 @@ namespace lambda {
 		T_tptr(T* t,bool do_push) LAMBDA_INLINE : base(), m_t(t) {if(do_push)this->push();}
 		// this must be a temporary!
 		T_tptr& operator=(const T_tptr& rhs);
-		void SetPtr(T* t) LAMBDA_INLINE { m_t=t; }
+		void SetPtr(T* t) LAMBDA_INLINE { m_t=t; this->update(t); }
 	private:
 		T* m_t;
 	};
@@ -288,6 +356,32 @@ namespace lambda {
 		T_ref& operator=(const T_ref& rhs);
 	};
 
+	////////////////////////////////////
+	// Roots
+
+	// walks all pointers on the stack of the current thread; the values may be NULL
+	class term_roots {
+	public:
+		term_roots() LAMBDA_INLINE : m_p(term_stack), m_s(shadow_base) {}
+		bool next(Term*& t) LAMBDA_INLINE {
+			if(Config::gc_shadow_stack){
+				while(m_s<shadow_top)
+					if((t=*m_s++)!=shadow_hole)
+						return true;
+				return false;
+			}else{
+				if(!m_p)
+					return false;
+				t=m_p->ptr();
+				m_p=m_p->peek();
+				return true;
+			}
+		}
+	private:
+		T_tptr<Term>* m_p;
+		Term** m_s;
+	};
+
 	////////////////////////////////////
 	// Term types
 	
@@ -21,6 +21,12 @@ along with lambda.  If not, see <http://www.gnu.org/licenses/>.
 #define __LAMBDA_STATS_H
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <typeinfo>
+#include <cxxabi.h>
 
 #include <lambda/config.h>
 #include <lambda/debug.h>
@@ -41,8 +47,34 @@ namespace lambda {
 		static void Double(){AtomicInc(&s.doubles);}
 		static void Postponed(){AtomicInc(&s.postponed);}
 		static void Worker(){AtomicInc(&s.workers);}
-		static void Macroblock(){worker_dump_memusage(AtomicInc(&s.macroblocks)*Config::macroblock_size);}
+		static void Macroblock(){worker_dump_memusage((AtomicInc(&s.macroblocks)-s.returned)*Config::macroblock_size);}
+		static void MacroblockReturned(){worker_dump_memusage((s.macroblocks-AtomicInc(&s.returned))*Config::macroblock_size);}
+		static unsigned long long int Now(){
+			struct timeval tv;
+			return gettimeofday(&tv,NULL)?0:(unsigned long long int)tv.tv_sec*1000000ULL+(unsigned long long int)tv.tv_usec;
+		}
+		// global GC pause of one worker, which started at the given Now()
+		static void Pause(unsigned long long int start){
+			unsigned long long int us=Now()-start;
+			unsigned long long int n=AtomicInc(&s.pauses);
+			if(n<=Config::stats_pauses)
+				s.pause[n-1]=us;
+			unsigned long long int max;
+			while((max=s.pause_max)<us&&atomic_cas(const_cast<unsigned long long int*>(&s.pause_max),max,us)!=max);
+		}
 		static void Print(){
+			unsigned long long int p99=0,pauses=s.pauses;
+			if(pauses>0){
+				size_t n=pauses<Config::stats_pauses?(size_t)pauses:Config::stats_pauses;
+				unsigned long long int* p=(unsigned long long int*)malloc(n*sizeof(unsigned long long int));
+				if(p){
+					for(size_t i=0;i<n;i++)
+						p[i]=s.pause[i];
+					qsort(p,n,sizeof(*p),ComparePause);
+					p99=p[(n*99)/100<n?(n*99)/100:n-1];
+					free(p);
+				}
+			}
 			print_lock();
 			printf("Stats:\n"
 				"    locals      : %10llu\n"
@@ -52,10 +84,12 @@ namespace lambda {
 				"    doubles     : %10llu\n"
 				"    postponed   : %10llu\n"
 				"    workers     : %10llu\n"
-				"    macroblocks : %10llu (%llu KB)\n",
+				"    macroblocks : %10llu (%llu KB, %llu returned)\n"
+				"    gc pauses   : %10llu (max %llu us, p99 %llu us)\n",
 				(unsigned long long int)s.locals,(unsigned long long int)s.globals,(unsigned long long int)s.applications,
 				(unsigned long long int)s.stalls,(unsigned long long int)s.doubles,(unsigned long long int)s.postponed,(unsigned long long int)s.workers,
-				(unsigned long long int)s.macroblocks,(unsigned long long int)s.macroblocks*Config::macroblock_size/1024
+				(unsigned long long int)s.macroblocks,(unsigned long long int)s.macroblocks*Config::macroblock_size/1024,(unsigned long long int)s.returned,
+				(unsigned long long int)s.pauses,(unsigned long long int)s.pause_max,p99
 				);
 			print_unlock();
 		}
@@ -63,9 +97,15 @@ namespace lambda {
 		template <typename T> static T AtomicInc(T* t){
 			return atomic_add(const_cast<typename lambda::cv_type<typeof(*t)>::type_nc*>(t),1ULL);
 		}
+		static int ComparePause(const void* a,const void* b){
+			unsigned long long int x=*(const unsigned long long int*)a,y=*(const unsigned long long int*)b;
+			return x<y?-1:x>y?1:0;
+		}
 	private:
 		typedef struct {
-			shared_t<unsigned long long int>::type locals,globals,applications,stalls,doubles,postponed,workers,macroblocks;
+			shared_t<unsigned long long int>::type locals,globals,applications,stalls,doubles,postponed,workers,macroblocks,returned;
+			shared_t<unsigned long long int>::type pauses,pause_max;
+			volatile_t<unsigned long long int>::type pause[Config::stats_pauses];
 		} s_t;
 		static s_t s;
 	};
@@ -82,6 +122,9 @@ namespace lambda {
 		static void Worker(){}
 		static void Print(){}
 		static void Macroblock(){}
+		static void MacroblockReturned(){}
+		static unsigned long long int Now(){return 0;}
+		static void Pause(unsigned long long int start){}
 	private:
 		typedef int s_t[0];
 		static s_t s;
@@ -89,6 +132,122 @@ namespace lambda {
 	
 	Stats<Config::enable_stats>::s_t Stats<Config::enable_stats>::s __attribute__((unused)) ATTR_SHARED_ALIGNMENT ={};
 
+#ifndef LAMBDA_CENSUS_PREFIX
+#  define LAMBDA_CENSUS_PREFIX lambda_census
+#endif
+
+	// the census site of the function that this worker is executing, see Function::ApplyNow()
+	DECL_THREAD_LOCAL_PTR(unsigned char,census_site)
+#define census_site DECL_THREAD_LOCAL_PTR_NAME(census_site,5)
+
+	// Live terms per type and per allocating function, counted by a worker while marking.
+	template <bool enable=Config::gc_census> class Census {
+	public:
+		static unsigned char Site(const char* label){return 0;}
+		template <typename T> static void Type(size_t size){}
+		void Count(const std::type_info& type,unsigned char site){}
+		void Other(size_t bytes){}
+		void Dump(const char* gc){}
+	};
+
+	template <>
+	class Census<true> : public Census<false> {
+	public:
+		// site 0 is the runtime itself, the last one collects all functions that did not fit
+		enum { sites=256 };
+		Census() : m_fp(NULL), m_types(), m_sites(), m_other() {}
+		static unsigned char Site(const char* label){
+			unsigned int i=atomic_add(&s.nsites,1U);
+			if(i>=sites-1)
+				return sites-1;
+			s.site[i]=label;
+			return (unsigned char)i;
+		}
+		template <typename T> static void Type(size_t size){
+			static int id __attribute__((unused))=Register(typeid(T),size);
+		}
+		void Count(const std::type_info& type,unsigned char site){
+			int n=s.ntypes<Config::gc_census_types?s.ntypes:Config::gc_census_types;
+			for(int i=0;i<n;i++)
+				if(s.type[i].type&&*s.type[i].type==type){
+					m_types[i]++;
+					m_sites[site].count++;
+					m_sites[site].bytes+=s.type[i].size;
+					return;
+				}
+		}
+		// a NoTerm that survived
+		void Other(size_t bytes){
+			m_other.count++;
+			m_other.bytes+=bytes;
+		}
+		// write one row per type and per site, and start counting again
+		void Dump(const char* gc){
+			struct timeval tv;
+			if(!m_fp)
+				Open();
+			unsigned long long int now=gettimeofday(&tv,NULL)?0:(unsigned long long int)tv.tv_sec*1000ULL+tv.tv_usec/1000;
+			for(int i=0;i<Config::gc_census_types;i++)
+				if(m_types[i]){
+					fprintf(m_fp,"%llu,%s,type,\"%s\",%lu,%lu\n",now,gc,s.type[i].name,m_types[i],m_types[i]*s.type[i].size);
+					m_types[i]=0;
+				}
+			if(m_other.count)
+				fprintf(m_fp,"%llu,%s,type,\"NoTerm\",%lu,%lu\n",now,gc,m_other.count,m_other.bytes);
+			m_other=count_t();
+			for(int i=0;i<sites;i++)
+				if(m_sites[i].count){
+					fprintf(m_fp,"%llu,%s,site,\"%s\",%lu,%lu\n",now,gc,i==0?"(runtime)":i==sites-1||!s.site[i]?"(other)":s.site[i],m_sites[i].count,m_sites[i].bytes);
+					m_sites[i]=count_t();
+				}
+			fflush(m_fp);
+		}
+	protected:
+		static int Register(const std::type_info& type,size_t size){
+			int i=atomic_add(&s.ntypes,1)-1;
+			if(i<Config::gc_census_types){
+				int status;
+				char* name=abi::__cxa_demangle(type.name(),NULL,NULL,&status);
+				s.type[i].name=name?name:type.name();
+				s.type[i].size=size;
+				fence();
+				s.type[i].type=&type;
+			}
+			return i;
+		}
+		void Open(){
+			char* filename;
+			if(asprintf(&filename,STRINGIFY(LAMBDA_CENSUS_PREFIX) "_w%d.csv",worker_id())==-1)
+				Error("cannot open census file");
+			if((m_fp=fopen(filename,"w"))==NULL)
+				Error("cannot open census file %s: error %d, %s",filename,errno,strerror(errno));
+			fprintf(m_fp,"time_ms,gc,kind,name,count,bytes\n");
+			free(filename);
+		}
+	private:
+		struct count_t {
+			count_t() : count(), bytes() {}
+			size_t count,bytes;
+		};
+		typedef struct {
+			volatile int ntypes;
+			struct {
+				const std::type_info* volatile type;
+				const char* name;
+				size_t size;
+			} type[Config::gc_census_types];
+			volatile unsigned int nsites;
+			const char* volatile site[sites];
+		} s_t;
+		static s_t s;
+		FILE* m_fp;
+		size_t m_types[Config::gc_census_types];
+		count_t m_sites[sites];
+		count_t m_other;
+	};
+
+	Census<true>::s_t Census<true>::s __attribute__((unused)) ATTR_SHARED_ALIGNMENT ={};
+
 };
 
 #endif // __LAMBDA_STATS_H
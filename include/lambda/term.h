@@ -42,6 +42,11 @@ namespace lambda {
 	// implemented in lambda/worker.h
 	template <typename T> static void* term_alloc(size_t s);
 	static void term_free(void* p);
+	static void term_remember(Term* t);
+	static void term_snapshot(Term* t);
+	static bool term_marked(Term* t);
+	static void term_mark(Term* t);
+	static void term_unmark(Term* t);
 	static bool worker_halt();
 	static void worker_sleep(useconds_t* sleep=NULL);
 	static Stack<EvalTerm>& worker_eval_stack();
@@ -85,8 +90,8 @@ namespace lambda {
 	public:
 		enum type_t { type_int, type_float, type_complex, type_mpz, type_string, type_constant, type_function, type_unknown };
 		// construction
-		Term(bool birth=true) : m_marked(0) {if(birth)MarkBirth();}
-		Term(const Term& t,bool birth=true) : m_marked(0) {if(birth)MarkBirth();}
+		Term(bool birth=true) : m_marked(0), m_gen(young), m_site(Config::gc_census?census_site:0) {if(birth)MarkBirth();}
+		Term(const Term& t,bool birth=true) : m_marked(0), m_gen(young), m_site(t.m_site) {if(birth)MarkBirth();}
 		virtual ~Term(){
 #ifdef LAMBDA_DEBUG
 			MarkDead();
@@ -255,12 +260,13 @@ namespace lambda {
 			return *ind1;
 		}
 
-		enum life_t { unborn=0, active=1, old=2, dead=3 };
+		// the mark bit of a born term is kept by the heap, fixed terms live outside of it
+		enum life_t { unborn=0, born=1, fixed=2, dead=3 };
 		bool IsBorn(){return m_marked>unborn;}
-		virtual bool IsActive(){return m_marked==active;}
-		virtual bool NeedMarking(){return m_marked!=active;}
-		bool IsAlive(){return IsActive()||m_marked<=active;}
-		bool IsOld(){return !IsActive()&&m_marked==old;}
+		virtual bool IsActive(){return m_marked==fixed||(m_marked==born&&term_marked(this));}
+		virtual bool NeedMarking(){return m_marked!=born||!term_marked(this);}
+		bool IsAlive(){return m_marked==unborn||IsActive();}
+		bool IsOld(){return m_marked==born&&!IsActive();}
 		bool IsDead(){return m_marked==dead;}
 
 		virtual void MarkActive(Stack<Term*>& more_active){
@@ -269,13 +275,34 @@ namespace lambda {
 #ifdef LAMBDA_DEBUG
 			worker_check_stack();
 #endif
-			if(IsBorn())m_marked=active;}
-		void MarkOld(){if(IsBorn())m_marked=old;}
+			if(m_marked==born)term_mark(this);}
+		void MarkOld(){if(m_marked==born)term_unmark(this);}
+		enum gen_t { young=0, tenured=1, remembered=2 };
+		bool IsTenured(){return m_gen!=young;}
+		bool IsRemembered(){return m_gen==remembered;}
+		// tenured terms are not marked by a minor GC, globals not by a local one
+		bool IsAliveOrSkipped(){return IsAlive()||IsTenured()||IsGlobal();}
+		void MarkTenured(){m_gen=tenured;}
+		void Forget(){if(m_gen==remembered)m_gen=tenured;}
+		// call before storing a pointer in this term, a tenured term might get a young child
+		void WriteBarrier(){
+			if(unlikely(m_gen==tenured)){
+				m_gen=remembered;
+				term_remember(this);
+			}
+		}
+		// allocated during incremental marking, so alive without being traversed
+		void MarkAllocated(){if(m_marked==born)term_mark(this);}
+		// the census site of the function that allocated this term
+		unsigned char Site(){return m_site;}
+		// push the terms this term refers to right now
+		virtual void References(Stack<Term*>& s){}
 		String DotID(){return String("term_%p",this);}
 		String DotName(){return name(-1);}
 		virtual void DotFollow(Stack<Term*>& s){}
 	protected:
-		void MarkBirth(){m_marked=old;}
+		void MarkBirth(){m_marked=born;}
+		void MarkFixed(){m_marked=fixed;}
 		void MarkDead(){m_marked=dead;}
 		static void* operator new(size_t s);
 		template <typename T> static void* operator_new_t(size_t s){
@@ -285,7 +312,10 @@ namespace lambda {
 		virtual void Reconcile(){}
 		Term& operator=(Term& rhs); //don't!
 	protected:
-		int m_marked;
+		// bytes only, such that derived classes can use the tail padding
+		char m_marked;
+		char m_gen;
+		unsigned char m_site;
 	};
 	
 	String EvalTerm::name() const { return String("eval (%s) %s",modeName(mode),term->name().c_str()); }
@@ -488,12 +518,12 @@ namespace lambda {
 	public:
 		typedef Term_tref (*f_type)(Term&,Term&,Term&,Term&,Term&);
 
-		Function(Term_tref (*f)(void),const char* label=NULL)							: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(0), m_indirect(NULL), m_label(label) {}
-		Function(Term_tref (*f)(Term&),const char* label=NULL)							: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(1), m_indirect(NULL), m_label(label) {}
-		Function(Term_tref (*f)(Term&,Term&),const char* label=NULL)					: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(2), m_indirect(NULL), m_label(label) {}
-		Function(Term_tref (*f)(Term&,Term&,Term&),const char* label=NULL)				: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(3), m_indirect(NULL), m_label(label) {}
-		Function(Term_tref (*f)(Term&,Term&,Term&,Term&),const char* label=NULL)		: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(4), m_indirect(NULL), m_label(label) {}
-		Function(Term_tref (*f)(Term&,Term&,Term&,Term&,Term&),const char* label=NULL)	: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(5), m_indirect(NULL), m_label(label) {}
+		Function(Term_tref (*f)(void),const char* label=NULL)							: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(0), m_indirect(NULL), m_label(label), m_census() {MarkFixed();}
+		Function(Term_tref (*f)(Term&),const char* label=NULL)							: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(1), m_indirect(NULL), m_label(label), m_census() {MarkFixed();}
+		Function(Term_tref (*f)(Term&,Term&),const char* label=NULL)					: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(2), m_indirect(NULL), m_label(label), m_census() {MarkFixed();}
+		Function(Term_tref (*f)(Term&,Term&,Term&),const char* label=NULL)				: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(3), m_indirect(NULL), m_label(label), m_census() {MarkFixed();}
+		Function(Term_tref (*f)(Term&,Term&,Term&,Term&),const char* label=NULL)		: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(4), m_indirect(NULL), m_label(label), m_census() {MarkFixed();}
+		Function(Term_tref (*f)(Term&,Term&,Term&,Term&,Term&),const char* label=NULL)	: Term(), m_f(reinterpret_cast<typeof(m_f)>(f)), m_n(5), m_indirect(NULL), m_label(label), m_census() {MarkFixed();}
 		
 		virtual Term_tref Apply(Term& a);
 		virtual Term_tref Reduce() { 
@@ -580,25 +610,45 @@ namespace lambda {
 				Term_ref i=FollowFullIndirection();
 				return &i.ReduceApply(a1,a2,a3,a4,a5);
 			}else{
+				// attribute the terms that the function allocates to it
+				unsigned char site=Config::gc_census?census_site:0;
+				if(Config::gc_census)
+					census_site=CensusSite();
 				Term_ptr t=&m_f(*a1,*a2,*a3,*a4,*a5);
+				if(Config::gc_census)
+					census_site=site;
 				if(Arguments()==0)
 					SetIndirection(&t->Globalize());
 				return t;
 			}
 		}
+		// register this function at the census on first use
+		unsigned char CensusSite(){
+			if(!m_census)
+				atomic_cas(&m_census,(unsigned char)0,Census<>::Site(m_label?m_label:"(anonymous function)"));
+			return m_census;
+		}
 	private:
 		f_type const m_f;
 		int const m_n;
 		volatile_t<Term_ptr>::type m_indirect;
 		const char* m_label;
+		unsigned char m_census;
 	} ATTR_SHARED_ALIGNMENT;
 
+	// tuples and their selectors, as recognized by the GC
+	extern Function tuple;
+	extern Function fst;
+	extern Function snd;
+	extern Function head;
+	extern Function tail;
+
 	class Application : public Term {
 	public:
-		Application(Term& f,Term& a) : Term(), m_f(f), m_a(a), m_indirect(NULL,noflush) {LAMBDA_PRINT(vars,"new apply %s",name().c_str());}
-		Application(Application& a,bool make_global=false) : Term(a,false),
-			m_f((Term*)a.GetIndirection()?a.m_f:(Term&)MatchMemCtor(a.m_f,make_global)),
-			m_a((Term*)a.GetIndirection()?a.m_a:(Term&)MatchMemCtor(a.m_a,make_global,&m_f)),
+		Application(Term& f,Term& a) : Term(), m_reducing(), m_f(&f), m_a(&a), m_indirect(NULL,noflush) {LAMBDA_PRINT(vars,"new apply %s",name().c_str());}
+		Application(Application& a,bool make_global=false) : Term(a,false), m_reducing(),
+			m_f((Term*)a.GetIndirection()?a.m_f:&(Term&)MatchMemCtor(*a.m_f,make_global)),
+			m_a((Term*)a.GetIndirection()?a.m_a:&(Term&)MatchMemCtor(*a.m_a,make_global,m_f)),
 			m_indirect(MatchMemCtor((Term*)a.GetIndirection(),make_global),noflush) {
 			MarkBirth();
 		}
@@ -607,12 +657,12 @@ namespace lambda {
 			if(GetIndirection()){
 				LAMBDA_VALIDATE_TERM(*GetIndirection());
 				return *(SetIndirectionField(&FollowFullIndirection()));//*m_indirect;
-			}else if(m_f.Arguments()>1){
-				LAMBDA_PRINT(eval,"function %s requires %d arguments, not reducing",m_f.name().c_str(),m_f.Arguments());
+			}else if(m_f->Arguments()>1){
+				LAMBDA_PRINT(eval,"function %s requires %d arguments, not reducing",m_f->name().c_str(),m_f->Arguments());
 				return *this;
-			}else if(m_f.Arguments()<=0){
-				LAMBDA_PRINT(eval,"function %s requires no arguments, reduce that first",m_f.name().c_str());
-				worker_eval_stack().push(&m_f);
+			}else if(m_f->Arguments()<=0){
+				LAMBDA_PRINT(eval,"function %s requires no arguments, reduce that first",m_f->name().c_str());
+				worker_eval_stack().push(m_f);
 				return *this;//*SetIndirection(new Application(m_f,m_a));
 			}else{
 				Stats<>::Application();
@@ -642,10 +692,10 @@ namespace lambda {
 		virtual bool ReduceWillBlock(){
 			return GetIndirection()&&FollowFullIndirection().ReduceWillBlock();}
 		virtual bool ReduceApplyWillBlock(){
-			return GetIndirection()?FollowFullIndirection().ReduceApplyWillBlock():m_a.IsBlocked()||m_f.IsBlocked();}
-		virtual Term& BaseFunction(){return GetIndirection()?FollowFullIndirection().BaseFunction():m_f;}
-		Term& GetArgument(){return m_a;}
-		virtual bool IsReducable(){return GetIndirection()||m_f.Arguments()<=1;}
+			return GetIndirection()?FollowFullIndirection().ReduceApplyWillBlock():m_a->IsBlocked()||m_f->IsBlocked();}
+		virtual Term& BaseFunction(){return GetIndirection()?FollowFullIndirection().BaseFunction():*m_f;}
+		Term& GetArgument(){return *m_a;}
+		virtual bool IsReducable(){return GetIndirection()||m_f->Arguments()<=1;}
 		virtual bool IsIndirectable(){return true;}
 		virtual Term_tref ReduceApply(Term* a1=NULL,Term* a2=NULL,Term* a3=NULL,Term* a4=NULL,Term* a5=NULL){
 			if(GetIndirection()){
@@ -654,8 +704,8 @@ namespace lambda {
 				return i.ReduceApply(a1,a2,a3,a4,a5);
 			}else{
 //				LAMBDA_PRINT(eval,"apply %s (%p,%p,%p,%p,%p)",name().c_str(),a1,a2,a3,a4,a5);
-				LAMBDA_ASSERT(!IsGlobal()||(m_f.IsGlobal()&&m_a.IsGlobal()),"application of global %p by non-global %p/%p",this,&m_f,&m_a);
-				Term_ref f=m_f.ReduceApply(&m_a,a1,a2,a3,a4);
+				LAMBDA_ASSERT(!IsGlobal()||(m_f->IsGlobal()&&m_a->IsGlobal()),"application of global %p by non-global %p/%p",this,m_f,m_a);
+				Term_ref f=m_f->ReduceApply(m_a,a1,a2,a3,a4);
 				return a5?*new Application(f,*a5):f;
 			}
 		}
@@ -676,23 +726,49 @@ namespace lambda {
 				LAMBDA_PRINT(gc_details,"%s not marking active",name().c_str());
 			}else if(!NeedMarking()){
 				// already alive
-				LAMBDA_ASSERT(IsGlobal()||!GetIndirection()||GetIndirection()->IsAlive(),"alive %s indirects to dead %s",name().c_str(),GetIndirection()->name().c_str());
-				LAMBDA_ASSERT(IsGlobal()||GetIndirection()||m_f.IsAlive(),"alive %s applies to dead %s",name().c_str(),m_f.name().c_str());
-				LAMBDA_ASSERT(IsGlobal()||GetIndirection()||m_a.IsAlive(),"alive %s applies dead %s",name().c_str(),m_a.name().c_str());
+				LAMBDA_ASSERT(IsGlobal()||!GetIndirection()||GetIndirection()->IsAliveOrSkipped(),"alive %s indirects to dead %s",name().c_str(),GetIndirection()->name().c_str());
+				LAMBDA_ASSERT(IsGlobal()||GetIndirection()||m_f->IsAliveOrSkipped(),"alive %s applies to dead %s",name().c_str(),m_f->name().c_str());
+				LAMBDA_ASSERT(IsGlobal()||GetIndirection()||m_a->IsAliveOrSkipped(),"alive %s applies dead %s",name().c_str(),m_a->name().c_str());
 			}else{
 				// recursive marking
 				if(GetIndirection()){
 					LAMBDA_ASSERT(!IsGlobal()||GetIndirection()->IsGlobal(),"global %s indirects to non-global %s",name().c_str(),GetIndirection()->name().c_str());
 					more_active.push(SetIndirectionField(&FollowFullIndirection()));
+				}else if(Term* s=!IsGlobal()&&!m_reducing?Selected():NULL){
+					// a selector of an evaluated tuple does not keep the whole tuple alive, but only the
+					// element it refers to; all survivors are tenured after the GC, so no write barrier
+					LAMBDA_PRINT(gc_details,"%s selects %p",name().c_str(),s);
+					m_indirect.raw()=s;
+					more_active.push(s);
 				}else{
-					LAMBDA_ASSERT(!IsGlobal()||m_f.IsGlobal(),"global %s pointing to non-global function %p (%s)",name().c_str(),&m_f,typeid(m_f).name());
-					LAMBDA_ASSERT(!IsGlobal()||m_a.IsGlobal(),"global %s pointing to non-global argument %p (%s)",name().c_str(),&m_a,typeid(m_a).name());
-					more_active.push(&m_f);
-					more_active.push(&m_a);
+					if(!IsGlobal()&&!m_reducing){
+						// refer to the ends of indirection chains, such that the intermediate terms become garbage
+						m_f=&m_f->FollowFullIndirection();
+						m_a=&m_a->FollowFullIndirection();
+					}else if(Config::gc_compact_size>0){
+						// refer to evacuated globals by their new copy
+						m_f=SkipGlobalIndirection(m_f);
+						m_a=SkipGlobalIndirection(m_a);
+					}
+					LAMBDA_ASSERT(!IsGlobal()||m_f->IsGlobal(),"global %s pointing to non-global function %p (%s)",name().c_str(),m_f,typeid(*m_f).name());
+					LAMBDA_ASSERT(!IsGlobal()||m_a->IsGlobal(),"global %s pointing to non-global argument %p (%s)",name().c_str(),m_a,typeid(*m_a).name());
+					more_active.push(m_f);
+					more_active.push(m_a);
 				}
 				Term::MarkActive(more_active);
 			}
 		}
+		// flag the local applications that the reduction of t might be using right now, such that
+		// the GC does not collapse them; ReduceApply() recurses into the function of an application
+		static void MarkReducing(Term* t,Stack<Application*>& reducing){
+			Application* a;
+			while((a=dynamic_cast<Application*>(&t->FollowFullIndirection()))&&a->IsBorn()&&!a->IsGlobal()&&!a->m_reducing){
+				a->m_reducing=true;
+				reducing.push(a);
+				t=a->m_f;
+			}
+		}
+		void UnmarkReducing(){m_reducing=false;}
 		virtual String name(int depth=0){
 			if(!IsBorn())
 				return String("unborn %cpply@%p",IsGlobal()?'A':'a',this);
@@ -710,7 +786,7 @@ namespace lambda {
 				sprintf(indent_fmt,"    %%%ds",depth*2>98?98:depth*2);
 				char indent[100];
 				snprintf(indent,sizeof(indent),indent_fmt,"");
-				return String("%cpply%s@%p(\n%s%s,\n%s%s)",IsGlobal()?'A':'a',IsActive()?"!":"",this,indent,m_f.name(depth+1).c_str(),indent,m_a.name(depth+1).c_str());
+				return String("%cpply%s@%p(\n%s%s,\n%s%s)",IsGlobal()?'A':'a',IsActive()?"!":"",this,indent,m_f->name(depth+1).c_str(),indent,m_a->name(depth+1).c_str());
 			}
 		}
 		virtual type_t GetType(){return GetIndirection()?FollowFullIndirection().GetType():type_function;}
@@ -718,8 +794,17 @@ namespace lambda {
 			if(GetIndirection()){
 				s.push(&FollowFullIndirection());
 			}else{
-				s.push(&m_f);
-				s.push(&m_a);
+				s.push(m_f);
+				s.push(m_a);
+			}
+		}
+		virtual void References(Stack<Term*>& s){
+			Term* i=GetIndirection();
+			if(i){
+				s.push(i);
+			}else{
+				s.push(m_f);
+				s.push(m_a);
 			}
 		}
 		virtual Term* SetIndirection(Term* ind){
@@ -747,15 +832,32 @@ protected:
 		Term* GetIndirection() const {
 			return GetIndirectionField();
 		}
+		static Term* SkipGlobalIndirection(Term* t){return t->IsGlobal()?&t->FollowFullIndirection():t;}
+		// the element of the evaluated tuple that fst/snd/head/tail is applied to, or NULL
+		Term* Selected(){
+			int i=m_f==&fst||m_f==&head?0:m_f==&snd||m_f==&tail?1:-1;
+			if(i<0)
+				return NULL;
+			// tuple (l) (r) is an application of an application
+			Application* x=dynamic_cast<Application*>(&m_a->FollowFullIndirection());
+			if(!x||!x->IsBorn()||x->GetIndirection())
+				return NULL;
+			Application* p=dynamic_cast<Application*>(&x->m_f->FollowFullIndirection());
+			if(!p||!p->IsBorn()||p->GetIndirection()||&p->m_f->FollowFullIndirection()!=&tuple)
+				return NULL;
+			return i?x->m_a:p->m_a;
+		}
 	protected:
-		virtual Term* SetIndirectionField(Term* t){m_indirect.raw()=t; return t;}
-		virtual Term* SetIndirectionFieldWhen(Term* t,Term* old){m_indirect.raw()=t; return old;}
+		virtual Term* SetIndirectionField(Term* t){WriteBarrier(); m_indirect.raw()=t; return t;}
+		virtual Term* SetIndirectionFieldWhen(Term* t,Term* old){WriteBarrier(); m_indirect.raw()=t; return old;}
 		Term* GetIndirectionField() const {return m_indirect.raw();}
 		Term* SetIndirectionVolatileField(Term* t){m_indirect=t; return t;}
 		Term* SetIndirectionVolatileFieldWhen(Term* t,Term* old){return m_indirect.set_when(t,old);}
 	private:
-		Term& m_f;
-		Term& m_a;
+		// fits in the tail padding of Term
+		bool m_reducing;
+		Term* m_f;
+		Term* m_a;
 		volatile_t<Term*>::type m_indirect;
 	};
 
@@ -821,8 +923,9 @@ protected:
 //		void entry_x(){entry_x(*this);} // entry is usually called after reading the object's type, but before reading its data!
 //		static void entry_x(Global& that){}
 //		void exit_x(){LAMBDA_PRINT(misc,"flushing %p",this);}
-		Term* SetIndirectionField(Term* t){return base::SetIndirectionVolatileField(t);}
-		Term* SetIndirectionFieldWhen(Term* t,Term* old){return base::SetIndirectionVolatileFieldWhen(t,old);}
+		// the overwritten references are kept alive by incremental marking
+		Term* SetIndirectionField(Term* t){term_snapshot(this); return base::SetIndirectionVolatileField(t);}
+		Term* SetIndirectionFieldWhen(Term* t,Term* old){term_snapshot(this); return base::SetIndirectionVolatileFieldWhen(t,old);}
 		Term* GetIndirectionField(){return base::GetIndirectionVolatileField();}
 	} ATTR_SHARED_ALIGNMENT;
 
@@ -831,8 +934,8 @@ protected:
 			Term_ref i=FollowFullIndirection();
 			return i.term().Globalize(stack);
 		}else{
-			Term& gf=m_f.FollowFullIndirection();
-			Term& ga=m_a.FollowFullIndirection();
+			Term& gf=m_f->FollowFullIndirection();
+			Term& ga=m_a->FollowFullIndirection();
 			bool bf=gf.IsGlobal()||!gf.IsIndirectable(),ba=ga.IsGlobal()||!ga.IsIndirectable();
 			if(!bf||!ba)
 				stack.push(this);
@@ -864,9 +967,9 @@ protected:
 		typedef Global<T> base;
 //		Static() : base() {Reconcile();}
 //		template <typename A1> Static(A1 a1) : base(a1) {}
-		template <typename A1,typename A2> Static(A1& a1,A2& a2) : base(a1,a2) {}
-		template <typename A1> Static(const A1& a1) : base(a1) {}
-		template <typename A1> Static(A1* a1) : base(a1) {}
+		template <typename A1,typename A2> Static(A1& a1,A2& a2) : base(a1,a2) {this->MarkFixed();}
+		template <typename A1> Static(const A1& a1) : base(a1) {this->MarkFixed();}
+		template <typename A1> Static(A1* a1) : base(a1) {this->MarkFixed();}
 //		virtual Term_tref Globalize(Stack<EvalTerm>& stack) { return *this; }
 		virtual bool IsGlobal(){ return true; }
 //		virtual Term_tref Duplicate() { return *this; }
@@ -1004,11 +1107,14 @@ protected:
 				bool is_done=GetState(&result)==done;
 				if(!NeedMarking()){
 					// already alive
-					LAMBDA_ASSERT(IsGlobal()||is_done||m_t.IsAlive(),"alive %s indirects to dead %s",name().c_str(),m_t.name().c_str());
-					LAMBDA_ASSERT(IsGlobal()||!is_done||result->IsAlive(),"alive %s indirects to dead result %s",name().c_str(),result->name().c_str());
+					LAMBDA_ASSERT(IsGlobal()||is_done||m_t.IsAliveOrSkipped(),"alive %s indirects to dead %s",name().c_str(),m_t.name().c_str());
+					LAMBDA_ASSERT(IsGlobal()||!is_done||result->IsAliveOrSkipped(),"alive %s indirects to dead result %s",name().c_str(),result->name().c_str());
 				}else{
 					// recursive marking
-					if(is_done)
+					if(is_done&&!IsGlobal())
+						// skip the indirections of the result; all survivors are tenured after the GC, so no write barrier
+						more_active.push(SetIndirectionField(&result->FollowFullIndirection()));
+					else if(is_done)
 						more_active.push(result);
 					else
 						more_active.push(&m_t);
@@ -1050,6 +1156,7 @@ protected:
 			default:;
 			}
 		}
+		virtual void References(Stack<Term*>& s){DotFollow(s);}
 	protected:
 		state_t GetState(Term_ptr* result=NULL) {
 			Term* r=GetIndirectionField();
@@ -1085,6 +1192,7 @@ protected:
 					Stats<>::Double();
 				}
 				LAMBDA_PRINT(eval,"%s reduced to %s",name().c_str(),result->name().c_str());
+				WriteBarrier();
 				SetIndirectionField(result);
 				break;
 			}	
@@ -140,6 +140,88 @@ namespace lambda {
 
 	static TermQueue<2> queue;
 
+	// shared packets of globals to be marked, such that all workers help marking the global graph
+	class MarkPool {
+	public:
+		static const int K=Config::gc_mark_packet_size;
+		static const int N=K*Config::workers*2;
+		MarkPool() : m_lock(), m_top(0), m_idle(0), m_pool() {}
+
+		void Reset(){
+			m_top=0;
+			m_idle=0;
+		}
+		// move globals from the top of the given stack into the pool, when other workers might run out of work
+		void Share(Stack<Term*>& s){
+			if(K==0||Config::workers<2||m_top.flush()>=K)
+				return;
+			Term* keep[K>0?K:1];
+			int kept=0;
+			m_lock.lock();
+			int top=m_top.flush();
+			for(int i=0;i<K&&top<N;i++){
+				Term* t=s.pop();
+				if(!t)
+					break;
+				if(t->IsGlobal())
+					m_pool[top++]=t;
+				else
+					keep[kept++]=t;
+			}
+			fence();
+			m_top=top;
+			m_lock.unlock();
+			while(kept>0)
+				s.push(keep[--kept]);
+			LAMBDA_PRINT(gc_details,"shared mark packet, pool has %d terms",top);
+		}
+		// get a packet from the pool; returns false when all workers are out of work
+		bool Steal(Stack<Term*>& s){
+			if(K==0||Config::workers<2)
+				return false;
+			bool idle=false;
+			m_lock.lock();
+			while(true){
+				int top=m_top.flush();
+				if(top>0){
+					for(int i=0;i<K&&top>0;i++){
+						Term* t=m_pool[--top].flush();
+						s.push(t);
+					}
+					m_top=top;
+					if(idle)
+						m_idle=m_idle.flush()-1;
+					m_lock.unlock();
+					LAMBDA_PRINT(gc_details,"stole mark packet, pool has %d terms",top);
+					return true;
+				}
+				int idle_workers=m_idle.flush();
+				if(!idle){
+					idle=true;
+					m_idle=++idle_workers;
+				}
+				if(idle_workers==(int)Config::workers){
+					m_lock.unlock();
+					return false;
+				}
+				m_lock.unlock();
+#ifdef LAMBDA_PLATFORM_MAC
+				sched_yield();
+#else
+				pthread_yield();
+#endif
+				m_lock.lock();
+			}
+		}
+	private:
+		TermQueueLock<true> m_lock;
+		volatile_t<int>::type m_top;
+		volatile_t<int>::type m_idle;
+		volatile_t<Term*>::type m_pool[N>0?N:1];
+	};
+
+	static MarkPool mark_pool;
+
 	class Worker;
 
 //	static __thread Worker* current_worker;
@@ -239,13 +321,18 @@ namespace lambda {
 
 			unsigned int seed=(uintptr_t)pthread_self();
 			Term_ptr stack_end=NULL;
-			that->m_stack_top=&stack_end;
+			// the conservative GC scans the whole frame, as t might be stored above stack_end
+			that->m_stack_top=Config::gc_type==Config::gc_conservative?__builtin_frame_address(0):(void*)&stack_end;
 			Term_ptr t;
 			while(true){
 				switch(GetState()){
 				case global_gc:
 					that->InspectState(true);
 					break;
+				case global_mark:
+					// help marking before looking for work
+					if(that->GetHeap().MarkStep())
+						break;
 				case evaluate:
 					t=queue.Pop();
 					if(t){
@@ -258,6 +345,9 @@ namespace lambda {
 						that->SetVCDState(VCDDump<>::idle);
 						LAMBDA_PRINT(worker,"Worker done");
 						t=NULL;
+						// nothing local survives a spark
+						if(Config::gc_spark_regions)
+							that->GetHeap().DropLocals();
 						that->InspectState(true);
 
 //						if(Config::enable_vcd)
@@ -305,7 +395,7 @@ namespace lambda {
 		}
 		Heap<>& GetHeap(){return m_heap;}
 
-		enum state_t { startup, evaluate, global_gc, dot_dump, halt, shutdown };
+		enum state_t { startup, evaluate, global_gc, global_mark, dot_dump, halt, shutdown };
 		static void SetState(state_t s){
 			LAMBDA_PRINT(state,"setting system state to %d",s);
 			m_state=s;
@@ -321,6 +411,10 @@ namespace lambda {
 		static state_t GetState(){
 			return m_state.flush();
 		}
+		static bool SetStateWhen(state_t s,state_t old){
+			LAMBDA_PRINT(state,"setting system state to %d, when %d",s,old);
+			return m_state.set_when(s,old)==old;
+		}
 		bool InspectState(bool idle=false,bool main_thread=false){
 			switch(GetState()){
 			case startup:
@@ -330,6 +424,9 @@ namespace lambda {
 			case global_gc:
 				// enter global GC now
 				return GetHeap().DoGC(false);
+			case global_mark:
+				GetHeap().MarkStep();
+				return false;
 			case dot_dump:
 				LAMBDA_ASSERT(Config::enable_dot&&Config::dot_timed,"dot_dump state without dot support");
 				dot_dump_now();
@@ -388,6 +485,12 @@ namespace lambda {
 		VCDDump<>& GetVCD(){
 			return m_vcd;
 		}
+		void* StackTop(){
+			return m_stack_top;
+		}
+		void SetStackTop(void* top){
+			m_stack_top=top;
+		}
 		void CheckStack(){
 			if(m_stack_top){
 				uintptr_t stack_size=0;
@@ -431,7 +534,7 @@ namespace lambda {
 #  define global_gc_signo (SIGRTMIN<=SIGRTMAX?SIGRTMIN:SIGUSR1)
 #endif
 		static void HaltHandler(int sig){
-			if(GetState()==evaluate){
+			if(GetState()==evaluate||GetState()==global_mark){
 				SetState(halt);
 			}
 		}
@@ -445,7 +548,8 @@ namespace lambda {
 				Error("cannot register interrupt handler: error %d, %s",errno,strerror(errno));
 		}
 		static void GlobalGCHandler(int sig, siginfo_t* si,void* arg){
-			if(GetState()==evaluate){
+			// incremental marking that takes a whole interval is finished right away
+			if(GetState()==evaluate||GetState()==global_mark){
 				SetState(global_gc);
 			}
 		}
@@ -529,6 +633,7 @@ namespace lambda {
 	
 	int Worker::workers=0;
 	static int worker_id(){return current_worker?current_worker->Id():-1;}
+	static void* worker_stack_top(){return current_worker->StackTop();}
 	static bool gc_barrier_wait(bool reset_state){
 		LAMBDA_ASSERT(current_worker!=NULL,"cannot apply barrier on non-worker");
 		LAMBDA_PRINT(gc_details,"waiting for barrier...");
@@ -544,6 +649,11 @@ namespace lambda {
 		current_worker->SetState(Worker::global_gc);
 		return worker_inspect_state();
 	}
+	// ask for a global GC, which the workers enter when they inspect their state
+	static void gc_request_global(){
+		if(Worker::SetStateWhen(Worker::global_gc,Worker::evaluate))
+			LAMBDA_PRINT(gc,"global heap grew, request global GC");
+	}
 	static bool worker_halt(){
 		return current_worker->GetState()==Worker::halt;
 	}
@@ -563,6 +673,22 @@ namespace lambda {
 	static void queue_mark_active(Stack<Term*>& more_active){
 		queue.MarkActive(more_active);
 	}
+	static bool gc_marking_start(){
+		return Worker::SetStateWhen(Worker::global_mark,Worker::global_gc);
+	}
+	static void gc_marking_done(){
+		if(Worker::SetStateWhen(Worker::global_gc,Worker::global_mark))
+			LAMBDA_PRINT(gc,"incremental marking done");
+	}
+	static void gc_mark_reset(){
+		mark_pool.Reset();
+	}
+	static void gc_mark_share(Stack<Term*>& marking){
+		mark_pool.Share(marking);
+	}
+	static bool gc_mark_steal(Stack<Term*>& marking){
+		return mark_pool.Steal(marking);
+	}
 	static Stack<EvalTerm>& worker_eval_stack(){
 		return current_worker->GetEvalStack();
 	}
@@ -587,6 +713,17 @@ namespace lambda {
 		return current_worker->GetHeap().Alloc<T>(s);}
 	static void term_free(void* p){
 		current_worker->GetHeap().Free(p);}
+	static void term_remember(Term* t){
+		current_worker->GetHeap().Remember(t);}
+	static void term_snapshot(Term* t){
+		if(Config::gc_incremental&&Heap<>::IsMarking())
+			current_worker->GetHeap().Snapshot(t);}
+	static bool term_marked(Term* t){
+		return Heap<>::IsMarked(t);}
+	static void term_mark(Term* t){
+		Heap<>::Mark(t);}
+	static void term_unmark(Term* t){
+		Heap<>::Unmark(t);}
 	
 	static void* noterm_alloc(size_t s) __attribute__((malloc));
 	static void* noterm_alloc(size_t s){
@@ -607,10 +744,7 @@ namespace lambda {
 		}else if(p==NULL){
 			return noterm_alloc(new_s);
 		}else{
-			void* res=noterm_alloc(new_s);
-			memcpy(res,p,old_s);
-			noterm_free(p);
-			return res;
+			return current_worker->GetHeap().Realloc(p,old_s,new_s);
 		}
 	}
 